@@ -34,6 +34,8 @@ struct CoreExport Privilege
 	Anope::string desc;
 	/* Rank relative to other privileges */
 	int rank;
+	/* Id of the privilege's name, see PrivilegeManager::GetPrivilegeId */
+	unsigned id;
 
 	Privilege(const Anope::string &name, const Anope::string &desc, int rank);
 	bool operator==(const Privilege &other) const;
@@ -42,12 +44,36 @@ struct CoreExport Privilege
 class CoreExport PrivilegeManager
 {
 	static std::vector<Privilege> Privileges;
+	/* Ids given to privilege names */
+	static Anope::hash_map<unsigned> Ids;
+	/* Position of each privilege in Privileges by id, or -1 */
+	static std::vector<int> Positions;
+	static unsigned Generation;
+
+	static void Update();
  public:
 	static void AddPrivilege(Privilege p);
 	static void RemovePrivilege(Privilege &p);
 	static Privilege *FindPrivilege(const Anope::string &name);
 	static std::vector<Privilege> &GetPrivileges();
 	static void ClearPrivileges();
+
+	/** Get the id of a privilege name, giving it one if it doesn't have one yet.
+	 * Ids are small integers which are never reused, even if the privilege is removed.
+	 * @param name The privilege name
+	 * @return The id
+	 */
+	static unsigned GetPrivilegeId(const Anope::string &name);
+
+	/** Forget which privileges access entries were found to have. This must be called if
+	 * anything access providers use to determine privileges changes. Changes to privileges
+	 * and channel levels do this automatically.
+	 */
+	static void ClearCache();
+
+	/** Get a number which changes whenever ClearCache is called.
+	 */
+	static unsigned GetGeneration();
 };
 
 /* A provider of access. Only used for creating ChanAccesses, as
@@ -76,6 +102,9 @@ class CoreExport ChanAccess : public Serializable
 	Anope::string mask;
 	/* account this access entry is for, if any */
 	Serialize::Reference<NickCore> nc;
+	/* Which privileges this entry has by id, see HasPrivId */
+	mutable std::vector<bool> privileges;
+	mutable unsigned privileges_generation;
 
  public:
 	typedef std::vector<ChanAccess *> Path;
@@ -112,6 +141,13 @@ class CoreExport ChanAccess : public Serializable
 	 */
 	virtual bool HasPriv(const Anope::string &name) const = 0;
 
+	/** Check if this access entry has the given privilege, by the id of the privilege.
+	 * This is the same as HasPriv, but the result is remembered for every privilege
+	 * until PrivilegeManager::ClearCache is called.
+	 * @param priv The privilege id
+	 */
+	bool HasPrivId(unsigned priv) const;
+
 	/** Serialize the access given by this access entry into a human
 	 * readable form. chanserv/access will return a number, chanserv/xop
 	 * will be AOP, SOP, etc.
@@ -312,7 +312,11 @@ namespace Anope
 	{
 		inline size_t operator()(const string &s) const
 		{
-			return TR1NS::hash<std::string>()(s.lower().str());
+			/* FNV-1a over the case mapped string, without making a lowercase copy of it */
+			size_t h = 2166136261U;
+			for (string::const_iterator it = s.begin(), it_end = s.end(); it != it_end; ++it)
+				h = (h ^ Anope::tolower(*it)) * 16777619U;
+			return h;
 		}
 	};
 
@@ -328,7 +332,7 @@ namespace Anope
 	{
 		inline bool operator()(const string &s1, const string &s2) const
 		{
-			return s1.equals_ci(s2);
+			return s1.length() == s2.length() && !ci::ci_char_traits::compare(s1.c_str(), s2.c_str(), s1.length());
 		}
 	};
 
@@ -430,6 +434,37 @@ namespace Anope
 	 */
 	extern CoreExport bool Match(const string &str, const string &mask, bool case_sensitive = false, bool use_regex = false);
 
+	/** A wildcard mask which has been compiled to be matched against many times.
+	 * Match() matches masks the same way without compiling them, callers which
+	 * repeatedly match the same masks can keep these instead.
+	 */
+	class CoreExport Matcher
+	{
+		string mask;
+		bool case_sensitive;
+		/* The mask split on *, as offsets and lengths into mask. A mask without any * has one segment */
+		std::vector<std::pair<size_t, size_t> > segments;
+		/* The minimum length of a string which can match */
+		size_t min_length;
+
+		bool MatchSegment(const char *str, const std::pair<size_t, size_t> &segment) const;
+
+	 public:
+		/** Compile a mask
+		 * @param mask The pattern to check (e.g. foo*bar)
+		 * @param case_sensitive Whether or not the match is case sensitive
+		 */
+		Matcher(const string &mask, bool case_sensitive = false);
+
+		/** Check whether a string matches the mask
+		 * @param str The string to check
+		 * @return true if it matches
+		 */
+		bool Matches(const string &str) const;
+
+		inline const string &GetMask() const { return this->mask; }
+	};
+
 	/** Converts a string to hex
 	 * @param the data to be converted
 	 * @return a anope::string containing the hex value
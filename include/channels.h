@@ -40,6 +40,12 @@ class CoreExport Channel : public Base, public Extensible
 	 */
 	ModeList modes;
 
+	/* The entries of the list modes set on this channel, parsed and indexed
+	 * so users can be matched against them quickly. See MatchesList().
+	 */
+	struct ListModeIndex;
+	std::map<Anope::string, ListModeIndex *> list_indexes;
+
  public:
  	/* Channel name */
 	Anope::string name;
@@ -34,6 +34,9 @@ class CoreExport ExtensibleBase : public Service
 
 class CoreExport Extensible
 {
+	/* Marks the object as changed if it is serializable, as its items are serialized with it */
+	void QueueExtensibleUpdate();
+
  public:
 	std::set<ExtensibleBase *> extension_items;
 
@@ -95,6 +98,10 @@ class BaseExtensibleItem : public ExtensibleBase
 
 	void Unset(Extensible *obj) anope_override
 	{
+		/* Much cheaper to check than items, which has every object this is set on */
+		if (!obj->extension_items.count(this))
+			return;
+
 		T *value = Get(obj);
 		items.erase(obj);
 		obj->extension_items.erase(this);
@@ -185,18 +192,21 @@ class SerializableExtensibleItem : public PrimitiveExtensibleItem<T>
 template<>
 class SerializableExtensibleItem<bool> : public PrimitiveExtensibleItem<bool>
 {
+	/* Every object is unserialized with every item, so the field is looked up by key */
+	Serialize::Key key;
+
  public:
- 	SerializableExtensibleItem(Module *m, const Anope::string &n) : PrimitiveExtensibleItem<bool>(m, n) { }
+ 	SerializableExtensibleItem(Module *m, const Anope::string &n) : PrimitiveExtensibleItem<bool>(m, n), key(n) { }
 
 	void ExtensibleSerialize(const Extensible *e, const Serializable *s, Serialize::Data &data) const anope_override
 	{
-		data[this->name] << true;
+		data.Set(this->key, true);
 	}
 
 	void ExtensibleUnserialize(Extensible *e, Serializable *s, Serialize::Data &data) anope_override
 	{
-		bool b = false;
-		data[this->name] >> b;
+		bool b;
+		data.Get(this->key, b);
 		if (b)
 			this->Set(e);
 		else
@@ -235,7 +245,10 @@ T* Extensible::Extend(const Anope::string &name)
 {
 	ExtensibleRef<T> ref(name);
 	if (ref)
+	{
+		this->QueueExtensibleUpdate();
 		return ref->Set(this);
+	}
 
 	Log(LOG_DEBUG) << "Extend for nonexistent type " << name << " on " << static_cast<void *>(this);
 	return NULL;
@@ -255,7 +268,11 @@ void Extensible::Shrink(const Anope::string &name)
 {
 	ExtensibleRef<T> ref(name);
 	if (ref)
+	{
+		if (ref->HasExt(this))
+			this->QueueExtensibleUpdate();
 		ref->Unset(this);
+	}
 	else
 		Log(LOG_DEBUG) << "Shrink for nonexistent type " << name << " on " << static_cast<void *>(this);
 }
@@ -33,6 +33,18 @@ namespace Language
 	 */
 	extern void InitLanguages();
 
+	/** Load the language files of a domain for each of the languages we support.
+	 * If any are found the domain is added to Domains.
+	 * @param domain The domain, which is the module's name
+	 * @return true if a language file was found for the domain
+	 */
+	extern CoreExport bool AddDomain(const Anope::string &domain);
+
+	/** Unload the language files of a domain and remove it from Domains.
+	 * @param domain The domain
+	 */
+	extern CoreExport void RemoveDomain(const Anope::string &domain);
+
 	/** Translates a string to the default language.
 	 * @param string A string to translate
 	 * @return The translated string if found, else the original string.
@@ -66,5 +66,13 @@ struct BadWords
 	 */
 	virtual void ClearBadWords() = 0;
 
+	/** Get the revision of the badword list, which changes whenever a badword is
+	 * added, changed, or removed, so anything built from the list knows when to
+	 * rebuild it. No two lists ever have the same revision, even if one replaces
+	 * the other on the same channel
+	 * @return The revision
+	 */
+	virtual unsigned GetRevision() const = 0;
+
 	virtual void Check() = 0;
 };
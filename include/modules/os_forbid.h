@@ -41,6 +41,11 @@ class ForbidService : public Service
 
 	virtual void RemoveForbid(ForbidData *d) = 0;
 
+	/** Tell the service that the mask or type of a forbid it has has been changed
+	 * @param d The forbid
+	 */
+	virtual void UpdateForbid(ForbidData *d) = 0;
+
 	virtual ForbidData* CreateForbid() = 0;
 
 	virtual ForbidData *FindForbid(const Anope::string &mask, ForbidType type) = 0;
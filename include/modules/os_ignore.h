@@ -31,6 +31,10 @@ class IgnoreService : public Service
 
 	virtual void DelIgnore(IgnoreData *) = 0;
 
+	/** Tell the service that the mask or expiry of an ignore it has has been changed
+	 */
+	virtual void UpdateIgnore(IgnoreData *) = 0;
+
 	virtual void ClearIgnores() = 0;
 
 	virtual IgnoreData *Create() = 0;
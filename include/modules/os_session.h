@@ -46,6 +46,11 @@ class SessionService : public Service
 
 	virtual void DelException(Exception *e) = 0;
 
+	/** Tell the service that the mask or expiry of an exception it has has been changed
+	 * @param e The exception
+	 */
+	virtual void UpdateException(Exception *e) = 0;
+
 	virtual Exception *FindException(User *u) = 0;
 
 	virtual Exception *FindException(const Anope::string &host) = 0;
@@ -88,6 +93,8 @@ Serializable* Exception::Unserialize(Serializable *obj, Serialize::Data &data)
 
 	if (!obj)
 		session_service->AddException(ex);
+	else
+		session_service->UpdateException(ex);
 	return ex;
 }
 
@@ -20,6 +20,14 @@ class ChanServService : public Service
 	 * for a few minutes so no one can join or rejoin.
 	 */
 	virtual void Hold(Channel *c) = 0;
+
+	/** Have a channel checked for expiry at the given time. Channels are only
+	 * checked when they are due to expire, so modules which make a channel expire
+	 * earlier (or stop keeping one from expiring) from OnPreChanExpire must use this.
+	 * @param ci The channel
+	 * @param when When to check it
+	 */
+	virtual void ScheduleExpireCheck(ChannelInfo *ci, time_t when) = 0;
 };
 
 #endif // CHANSERV_H
@@ -19,6 +19,14 @@ class NickServService : public Service
 	virtual void Validate(User *u) = 0;
 	virtual void Collide(User *u, NickAlias *na) = 0;
 	virtual void Release(NickAlias *na) = 0;
+
+	/** Have a nick checked for expiry at the given time. Nicks are only checked
+	 * when they are due to expire, so modules which make a nick expire earlier
+	 * (or stop keeping one from expiring) from OnPreNickExpire must use this.
+	 * @param na The nick
+	 * @param when When to check it
+	 */
+	virtual void ScheduleExpireCheck(NickAlias *na, time_t when) = 0;
 };
 
 #endif // NICKSERV_H
@@ -66,6 +66,12 @@ class CoreExport OperType
 	/** Set of opertypes we inherit from
 	 */
 	std::set<OperType *> inheritances;
+
+	/** privs and commands compiled so they can be checked quickly, along with
+	 * the results of checking them. These are created when first needed.
+	 */
+	struct Rules;
+	mutable Rules *priv_rules, *command_rules;
  public:
  	/** Modes to set when someone identifys using this opertype
 	 */
@@ -82,6 +88,8 @@ class CoreExport OperType
 	 */
 	OperType(const Anope::string &nname);
 
+	~OperType();
+
 	/** Check whether this opertype has access to run the given command string.
 	 * @param cmdstr The string to check, e.g. botserv/set/private.
 	 * @return True if this opertype may run the specified command, false otherwise.
@@ -16,6 +16,75 @@
 #include "anope.h"
 #include "service.h"
 
+/** A message from the uplink which has been split into tokens in place. The
+ * tokens point into the original line (which must outlive this object), and are
+ * only copied into Anope::strings when a handler asks for one.
+ */
+class CoreExport MessageTokens
+{
+ public:
+	struct CoreExport Token
+	{
+		const char *data;
+		size_t length;
+
+		Token() : data(""), length(0) { }
+		Token(const char *d, size_t l) : data(d), length(l) { }
+
+		inline bool empty() const { return !length; }
+		inline char operator[](size_t i) const { return i < length ? data[i] : 0; }
+		inline Anope::string str() const { return Anope::string(data, length); }
+
+		bool equals_cs(const char *s) const;
+
+		/** Gets the next space separated word from this token, like spacesepstream does
+		 * @param pos Where to start looking, updated to after the word that is found
+		 * @param word Set to the word found
+		 * @return true if a word was found
+		 */
+		bool GetToken(size_t &pos, Token &word) const;
+	};
+
+ private:
+	static const unsigned InlineParams = 32;
+	Token inline_params[InlineParams];
+	/* Any parameters which do not fit in the above */
+	std::vector<Token> extra_params;
+	unsigned count;
+
+ public:
+	/* The source and command of the message, these may be empty */
+	Token source, command;
+
+	MessageTokens();
+
+	/** Wraps parameters which have already been split into strings
+	 * @param params The parameters, which must outlive this object
+	 */
+	MessageTokens(const std::vector<Anope::string> &params);
+
+	/** Add a parameter
+	 * @param data The start of the parameter
+	 * @param length The length of the parameter
+	 */
+	void Push(const char *data, size_t length);
+
+	inline unsigned size() const { return count; }
+	inline bool empty() const { return !count; }
+	inline const Token &operator[](unsigned i) const { return i < InlineParams ? inline_params[i] : extra_params[i - InlineParams]; }
+
+	/** Joins some of the parameters back together with single spaces
+	 * @param first The first parameter to join
+	 * @param last One past the last parameter to join
+	 */
+	Anope::string Join(unsigned first, unsigned last) const;
+
+	/** Copies all of the parameters into strings
+	 * @param params The vector to add the parameters to
+	 */
+	void GetParams(std::vector<Anope::string> &params) const;
+};
+
 /* Encapsultes the IRCd protocol we are speaking. */
 class CoreExport IRCDProto : public Service
 {
@@ -39,7 +108,24 @@ class CoreExport IRCDProto : public Service
 	virtual void SendNumericInternal(int numeric, const Anope::string &dest, const Anope::string &buf);
 
 	const Anope::string &GetProtocolName();
-	virtual void Parse(const Anope::string &, Anope::string &, Anope::string &, std::vector<Anope::string> &);
+
+	/* Returned by the old Parse below, so that it can not be overridden */
+	struct ObsoleteParse { };
+
+	/** Split a line received from the uplink into copies of its source, command, and
+	 * parameters. This is no longer used by Anope::Process, override Parse(buffer, tokens)
+	 * instead. Overriding this is a compile error, so that an override which would never
+	 * be called is not silently ignored.
+	 */
+	MARK_DEPRECATED virtual ObsoleteParse Parse(const Anope::string &, Anope::string &, Anope::string &, std::vector<Anope::string> &);
+
+	/** Split a line received from the uplink into its source, command, and
+	 * parameters, without copying any of them. This is what Anope::Process
+	 * uses; protocol modules with a different line format should override it.
+	 * @param buffer The line, which must outlive tokens
+	 * @param tokens The tokens of the line
+	 */
+	virtual void Parse(const Anope::string &buffer, MessageTokens &tokens);
 	virtual Anope::string Format(const Anope::string &source, const Anope::string &message);
 
 	/* Modes used by default by our clients */
@@ -277,8 +363,21 @@ class CoreExport IRCDMessage : public Service
  public:
 	IRCDMessage(Module *owner, const Anope::string &n, unsigned p = 0);
 	unsigned GetParamCount() const;
+
+	/** Find the handler for a message received from the uplink. Handlers are
+	 * cached by command until a service is added or removed.
+	 * @param command The command name, in any case
+	 * @return The handler for the command, or NULL if there is none
+	 */
+	static IRCDMessage *Find(const Anope::string &command);
 	virtual void Run(MessageSource &, const std::vector<Anope::string> &params) = 0;
 
+	/** Called with the tokens of a message, which have not been copied out of the
+	 * received line. By default this copies them into strings and calls the
+	 * above; handlers for frequent messages can override this instead.
+	 */
+	virtual void Run(MessageSource &, const MessageTokens &params);
+
 	void SetFlag(IRCDMessageFlag f) { flags.insert(f); }
 	bool HasFlag(IRCDMessageFlag f) const { return flags.count(f); }
 };
@@ -54,6 +54,13 @@ class CoreExport ChannelInfo : public Serializable, public Extensible
 	Serialize::Checker<std::vector<ChanAccess *> > access;			/* List of authorized users */
 	Serialize::Checker<std::vector<AutoKick *> > akick;			/* List of users to kickban */
 	Anope::map<int16_t> levels;
+	/* Index of the access list, and the access users were found to have by AccessFor */
+	struct AccessIndex;
+	AccessIndex *access_index;
+
+	void AccessChanged();
+	void FindAccess(const User *u, const NickCore *account, std::vector<std::vector<ChanAccess *> > &paths);
+	void FindAccess(const User *u, const NickCore *account, unsigned int depth, std::vector<std::vector<ChanAccess *> > &paths, std::vector<ChanAccess *> &path);
 
  public:
  	friend class ChanAccess;
@@ -135,6 +142,13 @@ class CoreExport ChannelInfo : public Serializable, public Extensible
 	AccessGroup AccessFor(const User *u, bool updateLastUsed = true);
 	AccessGroup AccessFor(const NickCore *nc, bool updateLastUsed = true);
 
+	/** Forget the access users were found to have by AccessFor on every channel.
+	 * This is done when access lists change, and must also be done when anything
+	 * else changes which access entries a user or account matches, such as nicks
+	 * being grouped or dropped.
+	 */
+	static void ClearAccessCache();
+
 	/** Get the size of the accss vector for this channel
 	 * @return The access vector size
 	 */
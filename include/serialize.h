@@ -19,6 +19,8 @@
 
 namespace Serialize
 {
+	class Key;
+
 	class Data
 	{
 	 public:
@@ -36,8 +38,79 @@ namespace Serialize
 
 		virtual void SetType(const Anope::string &key, Type t) { }
 		virtual Type GetType(const Anope::string &key) const { return DT_TEXT; }
+
+		/** Sets a field. By default this goes through the stream of the field,
+		 * data modules that can store values directly should override these.
+		 */
+		virtual void Set(const Key &key, int64_t value);
+		virtual void Set(const Key &key, const Anope::string &value);
+
+		/** Gets a field. Fields which are not set are read as 0 or as an empty string.
+		 * @return false if the field is not set or is empty
+		 */
+		virtual bool Get(const Key &key, int64_t &value);
+		virtual bool Get(const Key &key, Anope::string &value);
+
+		/** Gets an integer field into an integer of any type */
+		template<typename T> bool Get(const Key &key, T &value)
+		{
+			int64_t i;
+			bool b = this->Get(key, i);
+			value = static_cast<T>(i);
+			return b;
+		}
 	};
 
+	/** The name of a field, and the type of its values. The name is interned
+	 * when the key is constructed, so keys should be constructed once and kept.
+	 */
+	class CoreExport Key
+	{
+		const Anope::string *name;
+		unsigned id;
+		Data::Type type;
+
+	 public:
+		Key(const Anope::string &n, Data::Type t = Data::DT_TEXT);
+
+		const Anope::string &GetName() const { return *this->name; }
+
+		/** Gets the id of the key's name. Keys with the same name have the same id,
+		 * and ids are less than the number of names interned so far.
+		 */
+		unsigned GetId() const { return this->id; }
+
+		Data::Type GetType() const { return this->type; }
+
+		/** Gets the number of names interned so far */
+		static unsigned GetCount();
+	};
+
+	inline void Data::Set(const Key &key, int64_t value)
+	{
+		if (key.GetType() != DT_TEXT)
+			this->SetType(key.GetName(), key.GetType());
+		(*this)[key.GetName()] << value;
+	}
+
+	inline void Data::Set(const Key &key, const Anope::string &value)
+	{
+		if (key.GetType() != DT_TEXT)
+			this->SetType(key.GetName(), key.GetType());
+		(*this)[key.GetName()] << value;
+	}
+
+	inline bool Data::Get(const Key &key, int64_t &value)
+	{
+		value = 0;
+		return !((*this)[key.GetName()] >> value).fail();
+	}
+
+	inline bool Data::Get(const Key &key, Anope::string &value)
+	{
+		return !((*this)[key.GetName()] >> value).fail();
+	}
+
 	extern void RegisterTypes();
 	extern void CheckTypes();
 
@@ -59,6 +132,8 @@ class CoreExport Serializable : public virtual Base
 	 * constructed before other objects are if it isn't.
 	 */
 	static std::list<Serializable *> *SerializableItems;
+	/* Every serializable item which has been updated since it was last committed */
+	static std::set<Serializable *> *DirtyItems;
 	friend class Serialize::Type;
 	/* The type of item this object is */
 	Serialize::Type *s_type;
@@ -68,6 +143,10 @@ class CoreExport Serializable : public virtual Base
 	size_t last_commit;
 	/* The last time this object was committed to the database */
 	time_t last_commit_time;
+	/* Incremented every time this object is updated */
+	unsigned int generation;
+	/* The generation of this object last committed to the database */
+	unsigned int commit_generation;
 
  protected:
  	Serializable(const Anope::string &serialize_type);
@@ -84,11 +163,27 @@ class CoreExport Serializable : public virtual Base
 	/* Only used by redis, to ignore updates */
 	unsigned short redis_ignore;
 
-	/** Marks the object as potentially being updated "soon".
+	/** Marks the object as potentially being updated "soon". Database modules
+	 * are only told of the first update since the object was last committed.
 	 */
 	void QueueUpdate();
 
+	/** Check whether this object has been updated since it was last committed
+	 * to the database.
+	 */
+	bool IsDirty() const { return this->generation != this->commit_generation; }
+
+	/** Get the number of times this object has been updated
+	 */
+	unsigned int GetGeneration() const { return this->generation; }
+
+	/** Marks the current version of this object as committed to the database.
+	 */
+	void Commit();
+
 	bool IsCached(Serialize::Data &);
+	/** Marks the object as committed and remembers the hash of its serialized form
+	 */
 	void UpdateCache(Serialize::Data &);
 
 	bool IsTSCached();
@@ -102,6 +197,10 @@ class CoreExport Serializable : public virtual Base
 	virtual void Serialize(Serialize::Data &data) const = 0;
 
 	static const std::list<Serializable *> &GetItems();
+
+	/** Get every object which has been updated since it was last committed
+	 */
+	static const std::set<Serializable *> &GetDirtyItems();
 };
 
 /* A serializable type. There should be one of these classes for each type
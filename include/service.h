@@ -25,6 +25,8 @@ class CoreExport Service : public virtual Base
 {
 	static std::map<Anope::string, std::map<Anope::string, Service *> > Services;
 	static std::map<Anope::string, std::map<Anope::string, Anope::string> > Aliases;
+	/* Incremented whenever a service or alias is added or removed */
+	static unsigned Generation;
 
 	static Service *FindService(const std::map<Anope::string, Service *> &services, const std::map<Anope::string, Anope::string> *aliases, const Anope::string &n)
 	{
@@ -70,6 +72,7 @@ class CoreExport Service : public virtual Base
 	{
 		std::map<Anope::string, Anope::string> &smap = Aliases[t];
 		smap[n] = v;
+		++Generation;
 	}
 
 	static void DelAlias(const Anope::string &t, const Anope::string &n)
@@ -78,6 +81,15 @@ class CoreExport Service : public virtual Base
 		smap.erase(n);
 		if (smap.empty())
 			Aliases.erase(t);
+		++Generation;
+	}
+
+	/** Get the generation of the service list. This changes whenever a service
+	 * or an alias is added or removed, so lookups can be cached until it changes.
+	 */
+	static unsigned GetGeneration()
+	{
+		return Generation;
 	}
 
 	Module *owner;
@@ -102,6 +114,7 @@ class CoreExport Service : public virtual Base
 		if (smap.find(this->name) != smap.end())
 			throw ModuleException("Service " + this->type + " with name " + this->name + " already exists");
 		smap[this->name] = this;
+		++Generation;
 	}
 
 	void Unregister()
@@ -110,6 +123,7 @@ class CoreExport Service : public virtual Base
 		smap.erase(this->name);
 		if (smap.empty())
 			Services.erase(this->type);
+		++Generation;
 	}
 };
 
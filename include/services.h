@@ -42,6 +42,8 @@
 #include <bitset>
 #include <set>
 #include <algorithm>
+#include <functional>
+#include <queue>
 #include <iterator>
 
 #include "defs.h"
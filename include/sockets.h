@@ -16,6 +16,7 @@
 #include <netinet/in.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #endif
 
 #include "anope.h"
@@ -105,6 +106,9 @@ class CoreExport cidr
 	bool match(const sockaddrs &other);
 	bool valid() const;
 
+	inline const sockaddrs &address() const { return this->addr; }
+	inline unsigned short length() const { return this->cidr_len; }
+
 	bool operator<(const cidr &other) const;
 	bool operator==(const cidr &other) const;
 	bool operator!=(const cidr &other) const;
@@ -115,6 +119,227 @@ class CoreExport cidr
 	};
 };
 
+/** A radix tree of CIDR ranges, which finds every range containing an address
+ * in time proportional to the length of the address rather than the number of ranges.
+ */
+template<typename T> class CIDRTree
+{
+	struct Node
+	{
+		unsigned char key[16];
+		unsigned short bits;
+		Node *children[2];
+		std::vector<T> values;
+
+		Node(const unsigned char *k, unsigned short b) : bits(b)
+		{
+			memcpy(key, k, sizeof(key));
+			children[0] = children[1] = NULL;
+		}
+
+		~Node()
+		{
+			delete children[0];
+			delete children[1];
+		}
+	};
+
+	/* One tree for IPv4 and one for IPv6 */
+	Node *roots[2];
+	size_t count;
+
+	CIDRTree(const CIDRTree &);
+	CIDRTree &operator=(const CIDRTree &);
+
+	static inline int Bit(const unsigned char *key, unsigned short bit)
+	{
+		return (key[bit / 8] >> (7 - bit % 8)) & 1;
+	}
+
+	/* Counts how many bits of a and b are the same, starting from the bit from */
+	static unsigned short CommonBits(const unsigned char *a, const unsigned char *b, unsigned short from, unsigned short max)
+	{
+		while (from < max && from % 8 && Bit(a, from) == Bit(b, from))
+			++from;
+		while (from + 8 <= max && a[from / 8] == b[from / 8])
+			from += 8;
+		while (from < max && Bit(a, from) == Bit(b, from))
+			++from;
+		return from;
+	}
+
+	static bool GetKey(const sockaddrs &addr, unsigned char key[16], int &tree, unsigned short &max)
+	{
+		memset(key, 0, 16);
+		switch (addr.sa.sa_family)
+		{
+			case AF_INET:
+				memcpy(key, &addr.sa4.sin_addr, 4);
+				tree = 0;
+				max = 32;
+				return true;
+			case AF_INET6:
+				memcpy(key, &addr.sa6.sin6_addr, 16);
+				tree = 1;
+				max = 128;
+				return true;
+		}
+		return false;
+	}
+
+ public:
+	CIDRTree() : count(0)
+	{
+		roots[0] = roots[1] = NULL;
+	}
+
+	~CIDRTree()
+	{
+		this->clear();
+	}
+
+	void clear()
+	{
+		delete roots[0];
+		delete roots[1];
+		roots[0] = roots[1] = NULL;
+		count = 0;
+	}
+
+	inline size_t size() const { return count; }
+	inline bool empty() const { return !count; }
+
+	/** Add a range to the tree
+	 * @param range The range
+	 * @param value The value to store for the range. A range can have many values.
+	 */
+	void insert(const cidr &range, const T &value)
+	{
+		unsigned char key[16];
+		int tree;
+		unsigned short max;
+		if (!range.valid() || !GetKey(range.address(), key, tree, max))
+			return;
+		unsigned short len = std::min(range.length(), max);
+
+		if (!roots[tree])
+			roots[tree] = new Node(key, 0);
+
+		for (Node *node = roots[tree];;)
+		{
+			if (node->bits == len)
+			{
+				node->values.push_back(value);
+				break;
+			}
+
+			Node *&child = node->children[Bit(key, node->bits)];
+			if (!child)
+			{
+				child = new Node(key, len);
+				child->values.push_back(value);
+				break;
+			}
+
+			unsigned short common = CommonBits(key, child->key, node->bits, std::min(len, child->bits));
+			if (common == child->bits)
+			{
+				node = child;
+				continue;
+			}
+
+			/* The range diverges from the child part way through it, so split it */
+			Node *split = new Node(key, common);
+			split->children[Bit(child->key, common)] = child;
+			child = split;
+			node = split;
+		}
+
+		++count;
+	}
+
+	/** Remove a value of a range from the tree
+	 * @param range The range
+	 * @param value The value
+	 * @return true if the value was found and removed
+	 */
+	bool erase(const cidr &range, const T &value)
+	{
+		unsigned char key[16];
+		int tree;
+		unsigned short max;
+		if (!range.valid() || !GetKey(range.address(), key, tree, max))
+			return false;
+		unsigned short len = std::min(range.length(), max);
+
+		/* The links followed to get to the node, so empty nodes can be removed after */
+		std::vector<Node **> path;
+		Node **link = &roots[tree];
+		while (*link && (*link)->bits < len)
+		{
+			path.push_back(link);
+			link = &(*link)->children[Bit(key, (*link)->bits)];
+		}
+
+		Node *node = *link;
+		if (!node || node->bits != len || CommonBits(key, node->key, 0, len) != len)
+			return false;
+
+		typename std::vector<T>::iterator it = std::find(node->values.begin(), node->values.end(), value);
+		if (it == node->values.end())
+			return false;
+		node->values.erase(it);
+		--count;
+
+		/* Remove nodes which no longer hold anything, and nodes which only join one other node */
+		for (path.push_back(link); !path.empty(); path.pop_back())
+		{
+			link = path.back();
+			node = *link;
+			if (!node->values.empty() || (node->children[0] && node->children[1]))
+				break;
+			/* The root always covers the whole address space */
+			if (link == &roots[tree] && (node->children[0] || node->children[1]))
+				break;
+
+			*link = node->children[0] ? node->children[0] : node->children[1];
+			node->children[0] = node->children[1] = NULL;
+			delete node;
+
+			if (*link)
+				break;
+		}
+
+		return true;
+	}
+
+	/** Find the values of every range which contains an address
+	 * @param addr The address
+	 * @param values The values are added to this
+	 */
+	void find(const sockaddrs &addr, std::vector<T> &values) const
+	{
+		unsigned char key[16];
+		int tree;
+		unsigned short max;
+		if (!addr.valid() || !GetKey(addr, key, tree, max))
+			return;
+
+		unsigned short checked = 0;
+		for (const Node *node = roots[tree]; node != NULL; node = node->children[Bit(key, node->bits)])
+		{
+			checked = CommonBits(key, node->key, checked, node->bits);
+			if (checked != node->bits)
+				break;
+
+			values.insert(values.end(), node->values.begin(), node->values.end());
+
+			if (node->bits >= max)
+				break;
+		}
+	}
+};
+
 class SocketException : public CoreException
 {
  public:
@@ -162,6 +387,16 @@ class CoreExport SocketIO
 	virtual int Send(Socket *s, const char *buf, size_t sz);
 	int Send(Socket *s, const Anope::string &buf);
 
+	/** Write several buffers to the socket at once
+	 * The default implementation uses writev() for plain sockets, and falls
+	 * back to calling Send() once per buffer for any other socket IO.
+	 * @param s The socket
+	 * @param iov The buffers to write
+	 * @param iovcnt The number of buffers
+	 * @return The number of bytes written
+	 */
+	virtual int Send(Socket *s, const iovec *iov, int iovcnt);
+
 	/** Accept a connection from a socket
 	 * @param s The socket
 	 * @return The new socket
@@ -274,15 +509,75 @@ class CoreExport Socket
 	virtual void ProcessError();
 };
 
+/** A queue of data waiting to be written to a socket. Data is appended to the
+ * end of fixed size blocks, so queueing a message usually does not allocate,
+ * and the queue is written out with one Send() call for many blocks. Data which
+ * has only been partially written is never moved.
+ */
+class CoreExport SendQueue
+{
+	struct Block
+	{
+		char *data;
+		size_t start, end, size;
+	};
+
+	/* The blocks of queued data, only the last block has free space */
+	std::deque<Block> blocks;
+	/* An empty block kept around for reuse */
+	Block spare;
+	/* Total length of the queued data */
+	size_t length;
+
+	SendQueue(const SendQueue &);
+	SendQueue &operator=(const SendQueue &);
+
+ public:
+	static const size_t BlockSize = 16384;
+
+	SendQueue();
+	~SendQueue();
+
+	/** Add data to the end of the queue
+	 * @param buf The data
+	 * @param len The length of the data
+	 */
+	void Append(const char *buf, size_t len);
+
+	/** Remove data from the front of the queue
+	 * @param len The number of bytes to remove
+	 */
+	void Consume(size_t len);
+
+	/** Write as much of the queue as possible to the socket
+	 * @param s The socket
+	 * @return The return value of SocketIO::Send
+	 */
+	int Flush(Socket *s);
+
+	/** Fills the buffer array from the front of the queue
+	 * @param iov The buffers to fill
+	 * @param count The maximum number of buffers to fill
+	 * @return The number of buffers filled
+	 */
+	int GetBuffers(iovec *iov, int count) const;
+
+	inline bool empty() const { return length == 0; }
+	inline size_t size() const { return length; }
+};
+
 class CoreExport BufferedSocket : public virtual Socket
 {
  protected:
- 	/* Things read from the socket */
+ 	/* Things read from the socket, everything before read_offset has already been consumed */
  	Anope::string read_buffer;
+	size_t read_offset;
 	/* Things to be written to the socket */
-	Anope::string write_buffer;
+	SendQueue write_buffer;
 	/* How much data was received from this socket on this recv() */
 	int recv_len;
+	/* How many times this socket has been corked */
+	unsigned corked;
 
  public:
 	BufferedSocket();
@@ -302,6 +597,14 @@ class CoreExport BufferedSocket : public virtual Socket
 	 */
 	const Anope::string GetLine();
 
+	/** Gets the next line from the input buffer, if any, without copying it.
+	 * The line stays valid until the next call to ProcessRead().
+	 * @param line Set to the start of the line
+	 * @param len Set to the length of the line, excluding the line terminator
+	 * @return true if a line was found
+	 */
+	bool GetLine(const char *&line, size_t &len);
+
 	/** Write to the socket
 	* @param message The message
 	*/
@@ -311,6 +614,16 @@ class CoreExport BufferedSocket : public virtual Socket
 	void Write(const char *message, ...);
 	void Write(const Anope::string &message);
 
+	/** Cork the socket. Until a matching Uncork(), anything written is only queued,
+	 * so many small writes can be sent together.
+	 */
+	void Cork();
+
+	/** Uncork the socket. Once every Cork() has been matched, everything queued
+	 * is sent in one go if the socket is ready for it.
+	 */
+	void Uncork();
+
 	/** Get the length of the read buffer
 	 * @return The length of the read buffer
 	 */
@@ -325,18 +638,8 @@ class CoreExport BufferedSocket : public virtual Socket
 class CoreExport BinarySocket : public virtual Socket
 {
  protected:
-	struct DataBlock
-	{
-		char *orig;
-		char *buf;
-		size_t len;
-
-		DataBlock(const char *b, size_t l);
-		~DataBlock();
-	};
-
 	/* Data to be written out */
-	std::deque<DataBlock *> write_buffer;
+	SendQueue write_buffer;
 
  public:
 	BinarySocket();
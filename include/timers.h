@@ -16,6 +16,8 @@
 
 class CoreExport Timer
 {
+	friend class TimerManager;
+
  private:
  	/** The owner of the timer, if any
 	 */
@@ -37,6 +39,14 @@ class CoreExport Timer
 	 */
 	bool repeat;
 
+	/** The wheel level and slot this timer is linked into, -1 if it is not linked
+	 */
+	int level, slot;
+
+	/** Neighbouring timers in the same slot
+	 */
+	Timer *prev, *next;
+
  public:
 	/** Constructor, initializes the triggering time
 	 * @param time_from_now The number of seconds from now to trigger the timer
@@ -101,12 +111,44 @@ class CoreExport Timer
 /** This class manages sets of Timers, and triggers them at their defined times.
  * This will ensure timers are not missed, as well as removing timers that have
  * expired and allowing the addition of new ones.
+ *
+ * Timers are kept in a hierarchical timing wheel. Each level has 64 slots, and
+ * a slot on level n covers 64^n seconds. Adding, deleting and rescheduling a
+ * timer is constant time; timers on the higher levels are cascaded down to
+ * the lower levels as their slot comes due.
  */
 class CoreExport TimerManager
 {
-	/** A list of timers
+	static const int LevelBits = 6;
+	static const int Levels = 6;
+	static const int Slots = 1 << LevelBits;
+
+	struct Slot
+	{
+		Timer *head, *tail;
+	};
+
+	/** The timing wheel
+	 */
+	static Slot Wheel[Levels][Slots];
+
+	/** Timers too far in the future to fit on the wheel
+	 */
+	static Slot Overflow;
+
+	/** Number of timers on each level of the wheel
+	 */
+	static unsigned LevelCount[Levels];
+
+	/** The time the wheel has been advanced to
 	 */
-	static std::multimap<time_t, Timer *> Timers;
+	static time_t WheelTime;
+
+	static void Link(Slot &s, Timer *t);
+	static void Unlink(Timer *t);
+	static void Cascade(Slot &s);
+	static void Advance(time_t ctime);
+
  public:
 	/** Add a timer to the list
 	 * @param t A Timer derived class to add
@@ -126,6 +168,130 @@ class CoreExport TimerManager
 	/** Deletes all timers owned by the given module
 	 */
 	static void DeleteTimersFor(Module *m);
+
+	/** Find when the next timer is due. The result may be early for timers
+	 * that are further than 64 seconds away, which are cascaded down to
+	 * their exact slot when that time is reached.
+	 * @return The time the next timer is due, or -1 if there are no timers
+	 */
+	static time_t NextTimer();
+
+	/** Calculates how long the socket engine may wait for events before
+	 * it must return so the next timer can be run on time.
+	 * @param max The maximum number of milliseconds to wait
+	 * @return The number of milliseconds to wait
+	 */
+	static long GetTimeout(long max);
+};
+
+/** Measures how long something takes, in milliseconds
+ */
+class CoreExport ElapsedTimer
+{
+	time_t start_sec;
+	long start_usec;
+
+ public:
+	/** Constructor, starts the timer
+	 */
+	ElapsedTimer();
+
+	/** Start the timer again from now
+	 */
+	void Reset();
+
+	/** @return The milliseconds since the timer was started or reset
+	 */
+	long Elapsed() const;
+};
+
+/** Keeps objects ordered by the time they next need to be checked, for example to
+ * see whether they have expired, so that only the objects which are due need to be
+ * looked at. Each object is scheduled at most once, at the earliest time it was
+ * scheduled for. Objects must be unscheduled before they are deleted.
+ */
+template<typename T> class ExpiryQueue
+{
+	typedef std::pair<time_t, T> Entry;
+
+	/* Every time objects have been scheduled for, including times which have since
+	 * been replaced by an earlier time or unscheduled, which are skipped.
+	 */
+	std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > queue;
+	/* The time each object is currently scheduled for */
+	TR1NS::unordered_map<T, time_t> scheduled;
+
+ public:
+	/** Schedule an object to be checked. Does nothing if the object is
+	 * already scheduled for an earlier time.
+	 * @param obj The object
+	 * @param when When to check it
+	 */
+	void Schedule(const T &obj, time_t when)
+	{
+		std::pair<typename TR1NS::unordered_map<T, time_t>::iterator, bool> it = this->scheduled.insert(std::make_pair(obj, when));
+		if (!it.second)
+		{
+			if (it.first->second <= when)
+				return;
+			it.first->second = when;
+		}
+
+		this->queue.push(Entry(when, obj));
+	}
+
+	/** Stop checking an object
+	 * @param obj The object
+	 */
+	void Unschedule(const T &obj)
+	{
+		this->scheduled.erase(obj);
+	}
+
+	/** Check whether an object is scheduled
+	 * @param obj The object
+	 */
+	bool IsScheduled(const T &obj) const
+	{
+		return this->scheduled.count(obj);
+	}
+
+	/** Get the next object which is due, and unschedule it
+	 * @param now The time now
+	 * @param obj Set to the object
+	 * @return true if an object was due
+	 */
+	bool Next(time_t now, T &obj)
+	{
+		while (!this->queue.empty() && this->queue.top().first <= now)
+		{
+			Entry e = this->queue.top();
+			this->queue.pop();
+
+			typename TR1NS::unordered_map<T, time_t>::iterator it = this->scheduled.find(e.second);
+			if (it == this->scheduled.end() || it->second != e.first)
+				continue;
+
+			this->scheduled.erase(it);
+			obj = e.second;
+			return true;
+		}
+
+		return false;
+	}
+
+	/** Get the number of objects scheduled
+	 */
+	size_t size() const
+	{
+		return this->scheduled.size();
+	}
+
+	void clear()
+	{
+		this->queue = std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> >();
+		this->scheduled.clear();
+	}
 };
 
 #endif // TIMERS_H
@@ -56,6 +56,13 @@ class CoreExport XLineManager : public Service
 	Serialize::Checker<std::vector<XLine *> > xlines;
 	/* Akills can have the same IDs, sometimes */
 	static Serialize::Checker<std::multimap<Anope::string, XLine *, ci::less> > XLinesByUID;
+	/* Index of the xlines in this XLineManager, see GetIndexMask() */
+	struct Index;
+	Index *xline_index;
+	/* When expired xlines should next be looked for */
+	time_t next_expiry_check;
+
+	void Expire();
  public:
 	/* List of XLine managers we check users against in XLineManager::CheckAll */
 	static std::list<XLineManager *> XLineManagers;
@@ -114,6 +121,11 @@ class CoreExport XLineManager : public Service
 
 	void RemoveXLine(XLine *);
 
+	/** Index an entry again after its mask has been changed
+	 * @param x The entry
+	 */
+	void ReindexXLine(XLine *x);
+
 	/** Delete an entry from this XLineManager
 	 * @param x The entry
 	 * @return true if the entry was found and deleted, else false
@@ -158,6 +170,23 @@ class CoreExport XLineManager : public Service
 	 */
 	virtual bool Check(User *u, const XLine *x) = 0;
 
+	/** Gets the part of an xline which users are matched against by Check(), which the
+	 * xlines are indexed on so CheckAllXLines() only has to Check() the ones a user might match.
+	 * Masks without wildcards are looked up directly, masks like *.example.com and CIDR ranges
+	 * are looked up in trees, and anything else is checked against every user.
+	 * By default nothing is indexed.
+	 * @param x The xline
+	 * @return The mask, or an empty string to check the xline against every user
+	 */
+	virtual Anope::string GetIndexMask(const XLine *x);
+
+	/** Gets the strings of a user which are looked up in the index for the masks from
+	 * GetIndexMask(). The user's IP is always looked up in the CIDR ranges.
+	 * @param u The user
+	 * @param keys The strings are added to this
+	 */
+	virtual void GetIndexKeys(User *u, std::vector<Anope::string> &keys);
+
 	/** Called when a user matches a xline in this XLineManager
 	 * @param u The user
 	 * @param x The XLine they match
@@ -27,13 +27,20 @@ struct BadWordImpl : BadWord, Serializable
 	static Serializable* Unserialize(Serializable *obj, Serialize::Data &);
 };
 
+/* The last revision given to any channel's list. Revisions are never reused, not even by a
+ * channel whose list was removed and created again, so a revision is never mistaken for one
+ * of an older list.
+ */
+static unsigned last_revision = 0;
+
 struct BadWordsImpl : BadWords
 {
 	Serialize::Reference<ChannelInfo> ci;
 	typedef std::vector<BadWordImpl *> list;
 	Serialize::Checker<list> badwords;
+	unsigned revision;
 
-	BadWordsImpl(Extensible *obj) : ci(anope_dynamic_static_cast<ChannelInfo *>(obj)), badwords("BadWord") { }
+	BadWordsImpl(Extensible *obj) : ci(anope_dynamic_static_cast<ChannelInfo *>(obj)), badwords("BadWord"), revision(++last_revision) { }
 
 	~BadWordsImpl();
 
@@ -45,6 +52,7 @@ struct BadWordsImpl : BadWords
 		bw->type = type;
 
 		this->badwords->push_back(bw);
+		this->revision = ++last_revision;
 
 		FOREACH_MOD(OnBadWordAdd, (ci, bw));
 
@@ -82,6 +90,13 @@ struct BadWordsImpl : BadWords
 			delete this->badwords->back();
 	}
 
+	unsigned GetRevision() const anope_override
+	{
+		/* Bring the list up to date with the database first */
+		static_cast<void>(this->badwords->size());
+		return this->revision;
+	}
+
 	void Check() anope_override
 	{
 		if (this->badwords->empty())
@@ -109,7 +124,10 @@ BadWordImpl::~BadWordImpl()
 		{
 			BadWordsImpl::list::iterator it = std::find(badwords->badwords->begin(), badwords->badwords->end(), this);
 			if (it != badwords->badwords->end())
+			{
 				badwords->badwords->erase(it);
+				badwords->revision = ++last_revision;
+			}
 		}
 	}
 }
@@ -140,6 +158,7 @@ Serializable* BadWordImpl::Unserialize(Serializable *obj, Serialize::Data &data)
 	BadWordsImpl *bws = ci->Require<BadWordsImpl>("badwords");
 	if (!obj)
 		bws->badwords->push_back(bw);
+	bws->revision = ++last_revision;
 
 	return bw;
 }
@@ -984,6 +984,178 @@ struct UserData
 	Anope::string lastline;
 };
 
+/* A channel's bad words compiled into an Aho-Corasick automaton, so that a message
+ * is scanned once for all of them no matter how many there are.
+ */
+class BadWordMatcher
+{
+	struct Node
+	{
+		/* Transitions to the next nodes, sorted by character */
+		std::vector<std::pair<unsigned char, unsigned> > next;
+		/* The node for the longest suffix of this node's text which is also a node */
+		unsigned fail;
+		/* The nearest node along the fail links which ends any words, or 0 if none do */
+		unsigned output;
+		/* The indexes of the bad words which end at this node, in order */
+		std::vector<unsigned> words;
+
+		Node() : fail(0), output(0) { }
+
+		/* Finds the transition for c, the root is never a transition so 0 means there is none */
+		unsigned Next(unsigned char c) const
+		{
+			std::vector<std::pair<unsigned char, unsigned> >::const_iterator it = std::lower_bound(next.begin(), next.end(), std::make_pair(c, 0U));
+			return it != next.end() && it->first == c ? it->second : 0;
+		}
+	};
+
+	struct Word
+	{
+		size_t length;
+		BadWordType type;
+	};
+
+	/* Node 0 is the root */
+	std::vector<Node> nodes;
+	unsigned root_next[256];
+	std::vector<Word> words;
+	bool case_sensitive;
+	bool built;
+	unsigned revision, generation;
+
+	inline unsigned char Fold(char c) const
+	{
+		return this->case_sensitive ? c : Anope::toupper(c);
+	}
+
+	unsigned Step(unsigned state, unsigned char c) const
+	{
+		for (; state; state = this->nodes[state].fail)
+		{
+			unsigned next = this->nodes[state].Next(c);
+			if (next)
+				return next;
+		}
+		return this->root_next[c];
+	}
+
+	void Build(BadWords *badwords, bool cs)
+	{
+		this->nodes.assign(1, Node());
+		this->words.clear();
+		this->case_sensitive = cs;
+
+		for (unsigned i = 0, count = badwords->GetBadWordCount(); i < count; ++i)
+		{
+			const BadWord *bw = badwords->GetBadWord(i);
+
+			Word w;
+			w.length = bw->word.length();
+			w.type = bw->type;
+			this->words.push_back(w);
+
+			if (bw->word.empty())
+				continue; // Shouldn't happen
+
+			unsigned node = 0;
+			for (size_t j = 0; j < bw->word.length(); ++j)
+			{
+				unsigned char c = this->Fold(bw->word[j]);
+				unsigned next = this->nodes[node].Next(c);
+				if (!next)
+				{
+					next = this->nodes.size();
+					std::vector<std::pair<unsigned char, unsigned> > &transitions = this->nodes[node].next;
+					transitions.insert(std::lower_bound(transitions.begin(), transitions.end(), std::make_pair(c, 0U)), std::make_pair(c, next));
+					this->nodes.push_back(Node());
+				}
+				node = next;
+			}
+			this->nodes[node].words.push_back(i);
+		}
+
+		for (unsigned c = 0; c < 256; ++c)
+			this->root_next[c] = 0;
+		for (unsigned i = 0; i < this->nodes[0].next.size(); ++i)
+			this->root_next[this->nodes[0].next[i].first] = this->nodes[0].next[i].second;
+
+		/* Nodes are added to the queue breadth first, so a node's fail link is always to a node which is already done */
+		std::vector<unsigned> queue(1, 0);
+		for (unsigned i = 0; i < queue.size(); ++i)
+		{
+			unsigned parent = queue[i];
+
+			for (unsigned j = 0; j < this->nodes[parent].next.size(); ++j)
+			{
+				unsigned char c = this->nodes[parent].next[j].first;
+				unsigned node = this->nodes[parent].next[j].second;
+
+				unsigned fail = parent ? this->Step(this->nodes[parent].fail, c) : 0;
+				this->nodes[node].fail = fail;
+				this->nodes[node].output = this->nodes[fail].words.empty() ? this->nodes[fail].output : fail;
+
+				queue.push_back(node);
+			}
+		}
+	}
+
+ public:
+	BadWordMatcher(Extensible *) : case_sensitive(false), built(false), revision(0), generation(0) { }
+
+	/** Rebuilds the automaton if the bad words or configuration have changed since it was built
+	 * @param badwords The channel's bad words
+	 * @param cs Whether bad words are case sensitive
+	 * @param gen The generation of the configuration
+	 */
+	void Update(BadWords *badwords, bool cs, unsigned gen)
+	{
+		unsigned rev = badwords->GetRevision();
+		if (this->built && rev == this->revision && cs == this->case_sensitive && gen == this->generation)
+			return;
+
+		this->Build(badwords, cs);
+		this->built = true;
+		this->revision = rev;
+		this->generation = gen;
+	}
+
+	/** Finds the first bad word in the list which is in a message
+	 * @param buf The normalized message
+	 * @return The index of the bad word, or -1 if there are none
+	 */
+	int Find(const Anope::string &buf) const
+	{
+		int found = -1;
+		unsigned state = 0;
+
+		for (size_t i = 0, len = buf.length(); i < len && found != 0; ++i)
+		{
+			state = this->Step(state, this->Fold(buf[i]));
+
+			for (unsigned node = this->nodes[state].words.empty() ? this->nodes[state].output : state; node; node = this->nodes[node].output)
+			{
+				const std::vector<unsigned> &ending = this->nodes[node].words;
+
+				for (unsigned j = 0; j < ending.size() && (found < 0 || ending[j] < static_cast<unsigned>(found)); ++j)
+				{
+					const Word &w = this->words[ending[j]];
+					size_t start = i + 1 - w.length, end = i + 1;
+					bool word_start = start == 0 || buf[start - 1] == ' ', word_end = end == len || buf[end] == ' ';
+
+					if (w.type == BW_ANY || (w.type == BW_SINGLE && word_start && word_end) || (w.type == BW_START && word_start) || (w.type == BW_END && word_end))
+					{
+						found = ending[j];
+						break;
+					}
+				}
+			}
+		}
+
+		return found;
+	}
+};
+
 class BanDataPurger : public Timer
 {
  public:
@@ -1012,7 +1184,10 @@ class BSKick : public Module
 {
 	ExtensibleItem<BanData> bandata;
 	ExtensibleItem<UserData> userdata;
+	ExtensibleItem<BadWordMatcher> badwordmatcher;
 	KickerDataImpl::ExtensibleItem kickerdata;
+	/* Incremented when the configuration is reloaded, as the casemap may have changed */
+	unsigned config_generation;
 
 	CommandBSKick commandbskick;
 	CommandBSKickAMSG commandbskickamsg;
@@ -1091,7 +1266,9 @@ class BSKick : public Module
 	BSKick(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, VENDOR),
 		bandata(this, "bandata"),
 		userdata(this, "userdata"),
+		badwordmatcher(this, "badwordmatcher"),
 		kickerdata(this, "kickerdata"),
+		config_generation(0),
 
 		commandbskick(this),
 		commandbskickamsg(this), commandbskickbadwords(this), commandbskickbolds(this), commandbskickcaps(this),
@@ -1106,6 +1283,11 @@ class BSKick : public Module
 
 	}
 
+	void OnReload(Configuration::Conf *conf) anope_override
+	{
+		++config_generation;
+	}
+
 	void OnBotInfo(CommandSource &source, BotInfo *bi, ChannelInfo *ci, InfoFormatter &info) anope_override
 	{
 		if (!ci)
@@ -1328,7 +1510,6 @@ class BSKick : public Module
 		/* Bad words kicker */
 		if (kd->badwords)
 		{
-			bool mustkick = false;
 			BadWords *badwords = ci->GetExt<BadWords>("badwords");
 
 			/* Normalize the buffer */
@@ -1337,79 +1518,23 @@ class BSKick : public Module
 
 			/* Normalize can return an empty string if this only conains control codes etc */
 			if (badwords && !nbuf.empty())
-				for (unsigned i = 0; i < badwords->GetBadWordCount(); ++i)
-				{
-					const BadWord *bw = badwords->GetBadWord(i);
-
-					if (bw->word.empty())
-						continue; // Shouldn't happen
-
-					if (bw->word.length() > nbuf.length())
-						continue; // This can't ever match
-
-					if (bw->type == BW_ANY && ((casesensitive && nbuf.find(bw->word) != Anope::string::npos) || (!casesensitive && nbuf.find_ci(bw->word) != Anope::string::npos)))
-						mustkick = true;
-					else if (bw->type == BW_SINGLE)
-					{
-						size_t len = bw->word.length();
-
-						if ((casesensitive && bw->word.equals_cs(nbuf)) || (!casesensitive && bw->word.equals_ci(nbuf)))
-							mustkick = true;
-						else if (nbuf.find(' ') == len && ((casesensitive && bw->word.equals_cs(nbuf.substr(0, len))) || (!casesensitive && bw->word.equals_ci(nbuf.substr(0, len)))))
-							mustkick = true;
-						else
-						{
-							if (len < nbuf.length() && nbuf.rfind(' ') == nbuf.length() - len - 1 && ((casesensitive && nbuf.find(bw->word) == nbuf.length() - len) || (!casesensitive && nbuf.find_ci(bw->word) == nbuf.length() - len)))
-								mustkick = true;
-							else
-							{
-								Anope::string wordbuf = " " + bw->word + " ";
-
-								if ((casesensitive && nbuf.find(wordbuf) != Anope::string::npos) || (!casesensitive && nbuf.find_ci(wordbuf) != Anope::string::npos))
-									mustkick = true;
-							}
-						}
-					}
-					else if (bw->type == BW_START)
-					{
-						size_t len = bw->word.length();
-
-						if ((casesensitive && nbuf.substr(0, len).equals_cs(bw->word)) || (!casesensitive && nbuf.substr(0, len).equals_ci(bw->word)))
-							mustkick = true;
-						else
-						{
-							Anope::string wordbuf = " " + bw->word;
-
-							if ((casesensitive && nbuf.find(wordbuf) != Anope::string::npos) || (!casesensitive && nbuf.find_ci(wordbuf) != Anope::string::npos))
-								mustkick = true;
-						}
-					}
-					else if (bw->type == BW_END)
-					{
-						size_t len = bw->word.length();
-
-						if ((casesensitive && nbuf.substr(nbuf.length() - len).equals_cs(bw->word)) || (!casesensitive && nbuf.substr(nbuf.length() - len).equals_ci(bw->word)))
-							mustkick = true;
-						else
-						{
-							Anope::string wordbuf = bw->word + " ";
-
-							if ((casesensitive && nbuf.find(wordbuf) != Anope::string::npos) || (!casesensitive && nbuf.find_ci(wordbuf) != Anope::string::npos))
-								mustkick = true;
-						}
-					}
+			{
+				BadWordMatcher *matcher = badwordmatcher.Require(ci);
+				matcher->Update(badwords, casesensitive, config_generation);
 
-					if (mustkick)
-					{
-						check_ban(ci, u, kd, TTB_BADWORDS);
-						if (Config->GetModule(me)->Get<bool>("gentlebadwordreason"))
-							bot_kick(ci, u, _("Watch your language!"));
-						else
-							bot_kick(ci, u, _("Don't use the word \"%s\" on this channel!"), bw->word.c_str());
+				int i = matcher->Find(nbuf);
+				const BadWord *bw = i >= 0 ? badwords->GetBadWord(i) : NULL;
+				if (bw)
+				{
+					check_ban(ci, u, kd, TTB_BADWORDS);
+					if (Config->GetModule(me)->Get<bool>("gentlebadwordreason"))
+						bot_kick(ci, u, _("Watch your language!"));
+					else
+						bot_kick(ci, u, _("Don't use the word \"%s\" on this channel!"), bw->word.c_str());
 
-						return;
-					}
-				} /* for */
+					return;
+				}
+			}
 		} /* if badwords */
 
 		UserData *ud = GetUserData(u, c);
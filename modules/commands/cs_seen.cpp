@@ -21,6 +21,8 @@ struct SeenInfo;
 static SeenInfo *FindInfo(const Anope::string &nick);
 typedef Anope::hash_map<SeenInfo *> database_map;
 database_map database;
+/* Entries by when they are next due to be purged */
+static ExpiryQueue<SeenInfo *> expiries;
 
 struct SeenInfo : Serializable
 {
@@ -38,6 +40,8 @@ struct SeenInfo : Serializable
 
 	~SeenInfo()
 	{
+		expiries.Unschedule(this);
+
 		database_map::iterator iter = database.find(nick);
 		if (iter != database.end() && iter->second == this)
 			database.erase(iter);
@@ -376,34 +380,59 @@ class CSSeen : public Module
 	Serialize::Type seeninfo_type;
 	CommandSeen commandseen;
 	CommandOSSeen commandosseen;
+	time_t purgetime;
+	/* The purge time the entries were scheduled with, if this changes every entry is scheduled again */
+	time_t scheduled_purgetime;
+
+	/* The most entries checked in one tick */
+	static const unsigned MaxExpireChecks = 10000;
+
  public:
-	CSSeen(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, VENDOR), seeninfo_type("SeenInfo", SeenInfo::Unserialize), commandseen(this), commandosseen(this)
+	CSSeen(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, VENDOR), seeninfo_type("SeenInfo", SeenInfo::Unserialize), commandseen(this), commandosseen(this),
+		purgetime(0), scheduled_purgetime(0)
 	{
 	}
 
 	void OnReload(Configuration::Conf *conf) anope_override
 	{
 		simple = conf->GetModule(this)->Get<bool>("simple");
+		purgetime = conf->GetModule(this)->Get<time_t>("purgetime");
+		if (!purgetime)
+			purgetime = Anope::DoTime("30d");
 	}
 
 	void OnExpireTick() anope_override
 	{
 		size_t previous_size = database.size();
-		time_t purgetime = Config->GetModule(this)->Get<time_t>("purgetime");
-		if (!purgetime)
-			purgetime = Anope::DoTime("30d");
-		for (database_map::iterator it = database.begin(), it_end = database.end(); it != it_end;)
+
+		/* Entries loaded from the database are scheduled here, as are all entries if the purge time changes */
+		if (scheduled_purgetime != purgetime || expiries.size() != database.size())
 		{
-			database_map::iterator cur = it;
-			++it;
+			bool all = scheduled_purgetime != purgetime;
+
+			for (database_map::iterator it = database.begin(), it_end = database.end(); it != it_end; ++it)
+				if (all || !expiries.IsScheduled(it->second))
+				{
+					expiries.Unschedule(it->second);
+					expiries.Schedule(it->second, it->second->last + purgetime + 1);
+				}
+
+			scheduled_purgetime = purgetime;
+		}
 
-			if ((Anope::CurTime - cur->second->last) > purgetime)
+		unsigned checked = 0;
+		SeenInfo *info;
+		for (; checked < MaxExpireChecks && expiries.Next(Anope::CurTime, info); ++checked)
+		{
+			if ((Anope::CurTime - info->last) > purgetime)
 			{
-				Log(LOG_DEBUG) << cur->first << " was last seen " << Anope::strftime(cur->second->last) << ", purging entries";
-				delete cur->second;
+				Log(LOG_DEBUG) << info->nick << " was last seen " << Anope::strftime(info->last) << ", purging entries";
+				delete info;
 			}
+			else
+				expiries.Schedule(info, info->last + purgetime + 1);
 		}
-		Log(LOG_DEBUG) << "cs_seen: Purged database, checked " << previous_size << " nicks and removed " << (previous_size - database.size()) << " old entries.";
+		Log(LOG_DEBUG) << "cs_seen: Purged database, checked " << checked << " nicks and removed " << (previous_size - database.size()) << " old entries.";
 	}
 
 	void OnUserConnect(User *u, bool &exempt) anope_override
@@ -446,7 +475,11 @@ class CSSeen : public Module
 
 		SeenInfo* &info = database[nick];
 		if (!info)
+		{
 			info = new SeenInfo();
+			expiries.Schedule(info, Anope::CurTime + purgetime + 1);
+		}
+		info->QueueUpdate();
 		info->nick = nick;
 		info->vhost = u->GetVIdent() + "@" + u->GetDisplayedHost();
 		info->type = Type;
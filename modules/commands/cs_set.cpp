@@ -12,6 +12,8 @@
 #include "module.h"
 #include "modules/cs_mode.h"
 
+static ServiceReference<ChanServService> chanserv("ChanServService", "ChanServ");
+
 class CommandCSSet : public Command
 {
  public:
@@ -1067,6 +1069,8 @@ class CommandCSSetNoexpire : public Command
 		{
 			Log(LOG_ADMIN, source, this, ci) << "to disable noexpire";
 			ci->Shrink<bool>("CS_NO_EXPIRE");
+			if (chanserv)
+				chanserv->ScheduleExpireCheck(ci, Anope::CurTime);
 			source.Reply(_("Channel %s \002will\002 expire."), ci->name.c_str());
 		}
 		else
@@ -1220,10 +1224,18 @@ class CSSet : public Module
 		{
 			/* Channel mode +P or so was set, mark this channel as persistent */
 			if (mode->name == "PERM")
+			{
+				c->ci->QueueUpdate();
 				persist.Set(c->ci, true);
+			}
 
 			if (mode->type != MODE_STATUS && !c->syncing && Me->IsSynced() && (!inhabit || !inhabit->HasExt(c)))
+			{
+				/* The modes are only serialized when they are being kept */
+				if (keep_modes.HasExt(c->ci))
+					c->ci->QueueUpdate();
 				c->ci->last_modes = c->GetModes();
+			}
 		}
 
 		return EVENT_CONTINUE;
@@ -1233,12 +1245,19 @@ class CSSet : public Module
 	{
 		if (mode->name == "PERM")
 		{
-			if (c->ci)
+			if (c->ci && persist.HasExt(c->ci))
+			{
+				c->ci->QueueUpdate();
 				persist.Unset(c->ci);
+			}
 		}
 
 		if (c->ci && mode->type != MODE_STATUS && !c->syncing && Me->IsSynced() && (!inhabit || !inhabit->HasExt(c)))
+		{
+			if (keep_modes.HasExt(c->ci))
+				c->ci->QueueUpdate();
 			c->ci->last_modes = c->GetModes();
+		}
 
 		return EVENT_CONTINUE;
 	}
@@ -12,6 +12,8 @@
 #include "module.h"
 #include "modules/suspend.h"
 
+static ServiceReference<ChanServService> chanserv("ChanServService", "ChanServ");
+
 struct CSSuspendInfo : SuspendInfo, Serializable
 {
 	CSSuspendInfo(Extensible *) : Serializable("CSSuspendInfo") { }
@@ -253,11 +255,14 @@ class CSSuspend : public Module
 
 		if (si->expires < Anope::CurTime)
 		{
+			ci->QueueUpdate();
 			ci->last_used = Anope::CurTime;
 			suspend.Unset(ci);
 
 			Log(this) << "Expiring suspend for " << ci->name;
 		}
+		else if (chanserv)
+			chanserv->ScheduleExpireCheck(ci, si->expires + 1);
 	}
 
 	EventReturn OnCheckKick(User *u, Channel *c, Anope::string &mask, Anope::string &reason) anope_override
@@ -244,6 +244,7 @@ class CSTopic : public Module
 		}
 		else
 		{
+			c->ci->QueueUpdate();
 			c->ci->last_topic = c->topic;
 			c->ci->last_topic_setter = c->topic_setter;
 			c->ci->last_topic_time = c->topic_ts;
@@ -77,6 +77,7 @@ class CommandHSDelAll : public Command
 			for (unsigned i = 0; i < nc->aliases->size(); ++i)
 			{
 				na = nc->aliases->at(i);
+				na->QueueUpdate();
 				na->RemoveVhost();
 			}
 			Log(LOG_ADMIN, source, this) << "for all nicks in group " << nc->display;
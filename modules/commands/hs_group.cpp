@@ -30,6 +30,7 @@ class CommandHSGroup : public Command
 			NickAlias *nick = na->nc->aliases->at(i);
 			if (nick)
 			{
+				nick->QueueUpdate();
 				nick->SetVhost(na->GetVhostIdent(), na->GetVhostHost(), na->GetVhostCreator());
 				FOREACH_MOD(OnSetVhost, (nick));
 			}
@@ -115,7 +115,10 @@ class CommandHSSetAll : public Command
 		{
 			NickAlias *nick = na->nc->aliases->at(i);
 			if (nick)
+			{
+				nick->QueueUpdate();
 				nick->SetVhost(na->GetVhostIdent(), na->GetVhostHost(), na->GetVhostCreator());
+			}
 		}
 	}
 
@@ -176,6 +176,11 @@ class CommandMSSet : public Command
 				return;
 			}
 		}
+		/* The memo info is serialized with its owner */
+		if (ci)
+			ci->QueueUpdate();
+		else
+			nc->QueueUpdate();
 		mi->memomax = limit;
 		if (limit > 0)
 		{
@@ -40,6 +40,7 @@ class CommandNSAccess : public Command
 			return;
 		}
 
+		nc->QueueUpdate();
 		nc->AddAccess(mask);
 		Log(nc == source.GetAccount() ? LOG_COMMAND : LOG_ADMIN, source, this) << "to ADD mask " << mask << " to " << nc->display;
 		source.Reply(_("\002%s\002 added to %s's access list."), mask.c_str(), nc->display.c_str());
@@ -67,6 +68,7 @@ class CommandNSAccess : public Command
 			return;
 		}
 
+		nc->QueueUpdate();
 		nc->EraseAccess(mask);
 		Log(nc == source.GetAccount() ? LOG_COMMAND : LOG_ADMIN, source, this) << "to DELETE mask " << mask << " from " << nc->display;
 		source.Reply(_("\002%s\002 deleted from %s's access list."), mask.c_str(), nc->display.c_str());
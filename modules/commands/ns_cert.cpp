@@ -199,6 +199,7 @@ class CommandNSCert : public Command
 			return;
 		}
 
+		nc->QueueUpdate();
 		cl->AddCert(certfp);
 		Log(nc == source.GetAccount() ? LOG_COMMAND : LOG_ADMIN, source, this) << "to ADD certificate fingerprint " << certfp << " to " << nc->display;
 		source.Reply(_("\002%s\002 added to %s's certificate list."), certfp.c_str(), nc->display.c_str());
@@ -227,6 +228,7 @@ class CommandNSCert : public Command
 			return;
 		}
 
+		nc->QueueUpdate();
 		cl->EraseCert(certfp);
 		cl->Check();
 		Log(nc == source.GetAccount() ? LOG_COMMAND : LOG_ADMIN, source, this) << "to DELETE certificate fingerprint " << certfp << " from " << nc->display;
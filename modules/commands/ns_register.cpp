@@ -11,6 +11,8 @@
 
 #include "module.h"
 
+static ServiceReference<NickServService> nickserv("NickServService", "NickServ");
+
 static bool SendRegmail(User *u, const NickAlias *na, BotInfo *bi);
 
 class CommandNSConfirm : public Command
@@ -404,6 +406,8 @@ class NSRegister : public Module
 			time_t unconfirmed_expire = Config->GetModule(this)->Get<time_t>("unconfirmedexpire", "1d");
 			if (unconfirmed_expire && Anope::CurTime - na->time_registered >= unconfirmed_expire)
 				expire = true;
+			else if (unconfirmed_expire && nickserv)
+				nickserv->ScheduleExpireCheck(na, na->time_registered + unconfirmed_expire);
 		}
 	}
 };
@@ -11,6 +11,8 @@
 
 #include "module.h"
 
+static ServiceReference<NickServService> nickserv("NickServService", "NickServ");
+
 class CommandNSSet : public Command
 {
  public:
@@ -146,6 +148,7 @@ class CommandNSSetPassword : public Command
 
 		Log(LOG_COMMAND, source, this) << "to change their password";
 
+		source.nc->QueueUpdate();
 		Anope::Encrypt(param, source.nc->pass);
 		Anope::string tmp_pass;
 		if (Anope::Decrypt(source.nc->pass, tmp_pass) == 1)
@@ -212,6 +215,7 @@ class CommandNSSASetPassword : public Command
 
 		Log(LOG_ADMIN, source, this) << "to change the password of " << nc->display;
 
+		nc->QueueUpdate();
 		Anope::Encrypt(params[1], nc->pass);
 		Anope::string tmp_pass;
 		if (Anope::Decrypt(nc->pass, tmp_pass) == 1)
@@ -506,6 +510,7 @@ class CommandNSSetEmail : public Command
 		}
 		else
 		{
+			nc->QueueUpdate();
 			if (!param.empty())
 			{
 				Log(nc == source.GetAccount() ? LOG_COMMAND : LOG_ADMIN, source, this) << "to change the email of " << nc->display << " to " << param;
@@ -829,6 +834,7 @@ class CommandNSSetLanguage : public Command
 
 		Log(nc == source.GetAccount() ? LOG_COMMAND : LOG_ADMIN, source, this) << "to change the language of " << nc->display << " to " << param;
 
+		nc->QueueUpdate();
 		nc->language = param;
 		if (source.GetAccount() == nc)
 			source.Reply(_("Language changed to \002English\002."));
@@ -1132,6 +1138,8 @@ class CommandNSSASetNoexpire : public Command
 		{
 			Log(LOG_ADMIN, source, this) << "to disable noexpire for " << na->nick << " (" << na->nc->display << ")";
 			na->Shrink<bool>("NS_NO_EXPIRE");
+			if (nickserv)
+				nickserv->ScheduleExpireCheck(na, Anope::CurTime);
 			source.Reply(_("Nick %s \002will\002 expire."), na->nick.c_str());
 		}
 		else
@@ -1269,6 +1277,7 @@ class NSSet : public Module
 			{
 				if (params[0] == n->second)
 				{
+					uac->QueueUpdate();
 					uac->email = n->first;
 					Log(LOG_COMMAND, source, command) << "to confirm their email address change to " << uac->email;
 					source.Reply(_("Your email address has been changed to \002%s\002."), uac->email.c_str());
@@ -1322,13 +1331,22 @@ class NSSet : public Module
 	void OnUserModeSet(const MessageSource &setter, User *u, const Anope::string &mname) anope_override
 	{
 		if (u->Account() && setter.GetUser() == u)
+		{
+			/* The modes are only serialized when they are being kept */
+			if (keep_modes.HasExt(u->Account()))
+				u->Account()->QueueUpdate();
 			u->Account()->last_modes = u->GetModeList();
+		}
 	}
 
 	void OnUserModeUnset(const MessageSource &setter, User *u, const Anope::string &mname) anope_override
 	{
 		if (u->Account() && setter.GetUser() == u)
+		{
+			if (keep_modes.HasExt(u->Account()))
+				u->Account()->QueueUpdate();
 			u->Account()->last_modes = u->GetModeList();
+		}
 	}
 
 	void OnUserLogin(User *u) anope_override
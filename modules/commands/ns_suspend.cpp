@@ -122,6 +122,7 @@ class CommandNSSuspend : public Command
 
 			if (na2 && *na2->nc == *na->nc)
 			{
+				na2->QueueUpdate();
 				na2->last_quit = reason;
 
 				User *u2 = User::Find(na2->nick, true);
@@ -267,11 +268,20 @@ class NSSuspend : public Module
 
 		if (s->expires < Anope::CurTime)
 		{
+			na->QueueUpdate();
 			na->last_seen = Anope::CurTime;
 			suspend.Unset(na->nc);
 
 			Log(LOG_NORMAL, "nickserv/expire", Config->GetClient("NickServ")) << "Expiring suspend for " << na->nick;
+
+			/* The rest of the group may now expire */
+			if (nickserv)
+				for (unsigned i = 0; i < na->nc->aliases->size(); ++i)
+					if (na->nc->aliases->at(i) != na)
+						nickserv->ScheduleExpireCheck(na->nc->aliases->at(i), Anope::CurTime);
 		}
+		else if (nickserv)
+			nickserv->ScheduleExpireCheck(na, s->expires + 1);
 	}
 
 	EventReturn OnNickValidate(User *u, NickAlias *na) anope_override
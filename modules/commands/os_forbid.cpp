@@ -56,6 +56,8 @@ Serializable* ForbidDataImpl::Unserialize(Serializable *obj, Serialize::Data &da
 
 	if (!obj)
 		forbid_service->AddForbid(fb);
+	else
+		forbid_service->UpdateForbid(fb);
 	return fb;
 }
 
@@ -65,6 +67,132 @@ class MyForbidService : public ForbidService
 
 	inline std::vector<ForbidData *>& forbids(unsigned t) { return (*this->forbid_data)[t - 1]; }
 
+	struct RegexForbid
+	{
+		size_t pos;
+		Regex *regex;
+		/* Regexes which do not match are still matched as a wildcard mask, as Anope::Match does */
+		Anope::Matcher matcher;
+
+		RegexForbid(size_t p, const Anope::string &mask) : pos(p), regex(NULL), matcher(mask) { }
+	};
+
+	/* The forbids of one type split up by how they have to be matched. Everything
+	 * refers to forbids by their position in the list, as the last forbid in the
+	 * list which matches is the one which is found.
+	 */
+	struct ForbidIndex
+	{
+		/* Forbids without wildcards, by mask */
+		TR1NS::unordered_multimap<Anope::string, size_t, Anope::hash_ci, Anope::compare> exact;
+		/* Forbids with wildcards, in list order */
+		std::vector<std::pair<size_t, Anope::Matcher> > wildcards;
+		/* Forbids which are a regex, in list order */
+		std::vector<RegexForbid> regexes;
+		/* The regex engine the regexes were compiled with */
+		Anope::string engine;
+		Reference<RegexProvider> provider;
+		/* Whether this has been built from the list yet */
+		bool built;
+
+		ForbidIndex() : built(false) { }
+
+		~ForbidIndex()
+		{
+			this->ClearRegexes();
+		}
+
+		void ClearRegexes()
+		{
+			for (unsigned i = 0; i < this->regexes.size(); ++i)
+			{
+				/* Regexes are only deleted while their provider still exists, as their code is in its module */
+				if (this->provider)
+					delete this->regexes[i].regex;
+				this->regexes[i].regex = NULL;
+			}
+		}
+
+		void Clear()
+		{
+			this->ClearRegexes();
+			this->exact.clear();
+			this->wildcards.clear();
+			this->regexes.clear();
+			this->built = false;
+		}
+
+		void Compile(RegexForbid &rf, const Anope::string &mask)
+		{
+			if (!this->provider)
+				return;
+
+			try
+			{
+				rf.regex = this->provider->Compile(mask.substr(1, mask.length() - 2));
+			}
+			catch (const RegexException &ex)
+			{
+				Log(LOG_DEBUG) << ex.GetReason();
+			}
+		}
+
+		void Add(size_t pos, const Anope::string &mask)
+		{
+			if (mask.length() >= 2 && mask[0] == '/' && mask[mask.length() - 1] == '/')
+			{
+				this->regexes.push_back(RegexForbid(pos, mask));
+				this->Compile(this->regexes.back(), mask);
+			}
+			else if (mask.find_first_of("*?") != Anope::string::npos)
+				this->wildcards.push_back(std::make_pair(pos, Anope::Matcher(mask)));
+			else
+				this->exact.insert(std::make_pair(mask, pos));
+		}
+
+		/* Compiles the regexes again if the regex engine has been changed, loaded, or unloaded */
+		void CheckEngine(const std::vector<ForbidData *> &list)
+		{
+			const Anope::string &current = Config->GetBlock("options")->Get<const Anope::string>("regexengine");
+			if (current == this->engine && (this->provider || current.empty()))
+				return;
+
+			ServiceReference<RegexProvider> p("Regex", current);
+			if (current == this->engine && !p)
+			{
+				/* The provider has gone away, so the regexes compiled by it can not be used any more */
+				this->ClearRegexes();
+				return;
+			}
+
+			this->ClearRegexes();
+			this->engine = current;
+			this->provider = p ? *p : NULL;
+
+			for (unsigned i = 0; i < this->regexes.size(); ++i)
+				this->Compile(this->regexes[i], list[this->regexes[i].pos]->mask);
+		}
+	};
+
+	ForbidIndex indexes[FT_SIZE - 1];
+
+	ForbidIndex &index(unsigned t)
+	{
+		ForbidIndex &idx = this->indexes[t - 1];
+		const std::vector<ForbidData *> &list = this->forbids(t);
+
+		if (!idx.built)
+		{
+			idx.Clear();
+			for (size_t i = 0; i < list.size(); ++i)
+				idx.Add(i, list[i]->mask);
+			idx.built = true;
+		}
+		idx.CheckEngine(list);
+
+		return idx;
+	}
+
  public:
 	MyForbidService(Module *m) : ForbidService(m), forbid_data("ForbidData") { }
 
@@ -78,16 +206,42 @@ class MyForbidService : public ForbidService
 	void AddForbid(ForbidData *d) anope_override
 	{
 		this->forbids(d->type).push_back(d);
+
+		ForbidIndex &idx = this->indexes[d->type - 1];
+		if (idx.built)
+			idx.Add(this->forbids(d->type).size() - 1, d->mask);
 	}
 
 	void RemoveForbid(ForbidData *d) anope_override
 	{
 		std::vector<ForbidData *>::iterator it = std::find(this->forbids(d->type).begin(), this->forbids(d->type).end(), d);
 		if (it != this->forbids(d->type).end())
+		{
 			this->forbids(d->type).erase(it);
+			this->indexes[d->type - 1].Clear();
+		}
 		delete d;
 	}
 
+	void UpdateForbid(ForbidData *d) anope_override
+	{
+		for (unsigned j = FT_NICK; j < FT_SIZE; ++j)
+		{
+			std::vector<ForbidData *>::iterator it = std::find(this->forbids(j).begin(), this->forbids(j).end(), d);
+			if (it == this->forbids(j).end())
+				continue;
+
+			/* The forbid is indexed by its old mask, and may be in the list for its old type */
+			this->indexes[j - 1].Clear();
+			if (j != static_cast<unsigned>(d->type))
+			{
+				this->forbids(j).erase(it);
+				this->AddForbid(d);
+			}
+			return;
+		}
+	}
+
 	ForbidData *CreateForbid() anope_override
 	{
 		return new ForbidDataImpl();
@@ -95,14 +249,35 @@ class MyForbidService : public ForbidService
 
 	ForbidData *FindForbid(const Anope::string &mask, ForbidType ftype) anope_override
 	{
-		for (unsigned i = this->forbids(ftype).size(); i > 0; --i)
-		{
-			ForbidData *d = this->forbids(ftype)[i - 1];
+		ForbidIndex &idx = this->index(ftype);
+		const std::vector<ForbidData *> &list = this->forbids(ftype);
 
-			if (Anope::Match(mask, d->mask, false, true))
-				return d;
+		/* Positions are offset by one so that 0 means nothing has been found */
+		size_t found = 0;
+
+		typedef TR1NS::unordered_multimap<Anope::string, size_t, Anope::hash_ci, Anope::compare>::const_iterator exact_iterator;
+		std::pair<exact_iterator, exact_iterator> range = idx.exact.equal_range(mask);
+		for (exact_iterator it = range.first; it != range.second; ++it)
+			found = std::max(found, it->second + 1);
+
+		for (unsigned i = idx.wildcards.size(); i > 0 && idx.wildcards[i - 1].first >= found; --i)
+			if (idx.wildcards[i - 1].second.Matches(mask))
+			{
+				found = idx.wildcards[i - 1].first + 1;
+				break;
+			}
+
+		for (unsigned i = idx.regexes.size(); i > 0 && idx.regexes[i - 1].pos >= found; --i)
+		{
+			RegexForbid &rf = idx.regexes[i - 1];
+			if ((rf.regex && rf.regex->Matches(mask)) || rf.matcher.Matches(mask))
+			{
+				found = rf.pos + 1;
+				break;
+			}
 		}
-		return NULL;
+
+		return found ? list[found - 1] : NULL;
 	}
 
 	ForbidData *FindForbidExact(const Anope::string &mask, ForbidType ftype) anope_override
@@ -112,7 +287,12 @@ class MyForbidService : public ForbidService
 			ForbidData *d = this->forbids(ftype)[i - 1];
 
 			if (d->mask.equals_ci(mask))
+			{
+				/* The caller may change the mask */
+				this->indexes[ftype - 1].Clear();
+				anope_dynamic_static_cast<ForbidDataImpl *>(d)->QueueUpdate();
 				return d;
+			}
 		}
 		return NULL;
 	}
@@ -137,6 +317,7 @@ class MyForbidService : public ForbidService
 
 					Log(LOG_NORMAL, "expire/forbid", Config->GetClient("OperServ")) << "Expiring forbid for " << d->mask << " type " << ftype;
 					this->forbids(j).erase(this->forbids(j).begin() + i - 1);
+					this->indexes[j - 1].Clear();
 					delete d;
 				}
 				else
@@ -43,30 +43,200 @@ Serializable* IgnoreDataImpl::Unserialize(Serializable *obj, Serialize::Data &da
 	if (obj)
 		ign = anope_dynamic_static_cast<IgnoreDataImpl *>(obj);
 	else
-	{
 		ign = new IgnoreDataImpl();
-		ignore_service->AddIgnore(ign);
-	}
 
 	data["mask"] >> ign->mask;
 	data["creator"] >> ign->creator;
 	data["reason"] >> ign->reason;
 	data["time"] >> ign->time;
 
+	if (!obj)
+		ignore_service->AddIgnore(ign);
+	else
+		ignore_service->UpdateIgnore(ign);
 	return ign;
 }
 
 
+/* The last ignore found for a user, which is used again until either the
+ * user or the ignore list changes
+ */
+struct IgnoreVerdict
+{
+	unsigned generation;
+	Anope::string nick, ident, vident, host, chost, vhost, ip, realname;
+	IgnoreData *ign;
+
+	IgnoreVerdict(Extensible *) : generation(0), ign(NULL) { }
+
+	bool Valid(User *u, unsigned gen) const
+	{
+		return this->generation == gen && this->nick == u->nick && this->ident == u->GetIdent() && this->vident == u->GetVIdent() &&
+			this->host == u->host && this->chost == u->chost && this->vhost == u->vhost && this->ip == u->ip.addr() && this->realname == u->realname;
+	}
+
+	void Set(User *u, unsigned gen, IgnoreData *i)
+	{
+		this->generation = gen;
+		this->nick = u->nick;
+		this->ident = u->GetIdent();
+		this->vident = u->GetVIdent();
+		this->host = u->host;
+		this->chost = u->chost;
+		this->vhost = u->vhost;
+		this->ip = u->ip.addr();
+		this->realname = u->realname;
+		this->ign = i;
+	}
+};
+
 class OSIgnoreService : public IgnoreService
 {
 	Serialize::Checker<std::vector<IgnoreData *> > ignores;
 
+	typedef TR1NS::unordered_multimap<Anope::string, size_t, Anope::hash_ci, Anope::compare> position_map;
+
+	/* The ignores parsed, in list order */
+	std::vector<Entry> entries;
+	/* Ignores for a nick without wildcards */
+	position_map nicks;
+	/* Ignores for any nick and a host without wildcards */
+	position_map hosts;
+	/* Ignores for any nick and a CIDR range */
+	CIDRTree<size_t> ranges;
+	/* Everything else, which every user has to be checked against */
+	std::vector<size_t> others;
+	/* Whether the list has changed since the above were built */
+	bool changed;
+	/* Changes whenever the list does, to invalidate verdicts */
+	unsigned generation;
+
+	ExtensibleItem<IgnoreVerdict> verdicts;
+	ExpiryQueue<IgnoreData *> expiries;
+
+	void Changed()
+	{
+		this->changed = true;
+		++this->generation;
+	}
+
+	void Index(size_t pos)
+	{
+		const Entry &e = this->entries[pos];
+
+		if (!e.nick.empty() && e.nick.find_first_of("*?") == Anope::string::npos)
+			this->nicks.insert(std::make_pair(e.nick, pos));
+		else if (!e.nick.empty())
+			this->others.push_back(pos);
+		else if (e.cidr_len)
+		{
+			if ((e.family == AF_INET && e.cidr_len <= 32) || (e.family == AF_INET6 && e.cidr_len <= 128))
+				this->ranges.insert(cidr(e.host, e.cidr_len), pos);
+			else
+				this->others.push_back(pos);
+		}
+		else if (!e.host.empty() && e.host.find_first_of("*?") == Anope::string::npos)
+			this->hosts.insert(std::make_pair(e.host, pos));
+		else
+			this->others.push_back(pos);
+	}
+
+	void Build()
+	{
+		const std::vector<IgnoreData *> &list = *this->ignores;
+
+		if (!this->changed && this->entries.size() == list.size())
+			return;
+
+		this->entries.clear();
+		this->nicks.clear();
+		this->hosts.clear();
+		this->ranges.clear();
+		this->others.clear();
+
+		for (size_t i = 0; i < list.size(); ++i)
+		{
+			this->entries.push_back(Entry("", list[i]->mask));
+			this->Index(i);
+		}
+
+		this->changed = false;
+	}
+
+	/* Finds the first ignore in the list which matches a user */
+	IgnoreData *Match(User *u)
+	{
+		this->Build();
+
+		std::vector<size_t> candidates;
+
+		std::pair<position_map::const_iterator, position_map::const_iterator> range = this->nicks.equal_range(u->nick);
+		for (position_map::const_iterator it = range.first; it != range.second; ++it)
+			candidates.push_back(it->second);
+
+		const Anope::string ip = u->ip.addr();
+		const Anope::string *keys[] = { &u->GetDisplayedHost(), &u->GetCloakedHost(), &u->host, &ip };
+		for (unsigned i = 0; i < sizeof(keys) / sizeof(*keys); ++i)
+		{
+			range = this->hosts.equal_range(*keys[i]);
+			for (position_map::const_iterator it = range.first; it != range.second; ++it)
+				candidates.push_back(it->second);
+		}
+
+		this->ranges.find(u->ip, candidates);
+
+		std::sort(candidates.begin(), candidates.end());
+		candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+		/* Check the candidates and the ignores which can't be looked up together, in list order */
+		for (size_t c = 0, o = 0; c < candidates.size() || o < this->others.size();)
+		{
+			size_t pos;
+			if (o == this->others.size() || (c < candidates.size() && candidates[c] < this->others[o]))
+				pos = candidates[c++];
+			else
+				pos = this->others[o++];
+
+			if (this->entries[pos].Matches(u, true))
+				return (*this->ignores)[pos];
+		}
+
+		return NULL;
+	}
+
+	/* Expires an ignore if its time is up
+	 * @return true if it has been deleted
+	 */
+	static bool CheckExpire(IgnoreData *id)
+	{
+		if (id->time && !Anope::NoExpire && id->time <= Anope::CurTime)
+		{
+			Log(LOG_NORMAL, "expire/ignore", Config->GetClient("OperServ")) << "Expiring ignore entry " << id->mask;
+			delete id;
+			return true;
+		}
+
+		return false;
+	}
+
  public:
-	OSIgnoreService(Module *o) : IgnoreService(o), ignores("IgnoreData") { }
+	OSIgnoreService(Module *o) : IgnoreService(o), ignores("IgnoreData"), changed(true), generation(0), verdicts(o, "IGNORE_VERDICT") { }
 
 	void AddIgnore(IgnoreData *ign) anope_override
 	{
 		ignores->push_back(ign);
+
+		if (!this->changed && this->entries.size() == ignores->size() - 1)
+		{
+			this->entries.push_back(Entry("", ign->mask));
+			this->Index(this->entries.size() - 1);
+		}
+		else
+			this->changed = true;
+		++this->generation;
+
+		if (ign->time)
+			this->expiries.Schedule(ign, ign->time);
 	}
 
 	void DelIgnore(IgnoreData *ign) anope_override
@@ -74,6 +244,16 @@ class OSIgnoreService : public IgnoreService
 		std::vector<IgnoreData *>::iterator it = std::find(ignores->begin(), ignores->end(), ign);
 		if (it != ignores->end())
 			ignores->erase(it);
+		this->Changed();
+		this->expiries.Unschedule(ign);
+	}
+
+	void UpdateIgnore(IgnoreData *ign) anope_override
+	{
+		this->Changed();
+		/* An expiry which has been moved later is scheduled again when the earlier one is reached */
+		if (ign->time)
+			this->expiries.Schedule(ign, ign->time);
 	}
 
 	void ClearIgnores() anope_override
@@ -90,66 +270,75 @@ class OSIgnoreService : public IgnoreService
 		return new IgnoreDataImpl();
 	}
 
+	/** Find the ignore for a user, if any
+	 * @param u The user
+	 */
+	IgnoreData *Find(User *u)
+	{
+		IgnoreVerdict *v = this->verdicts.Get(u);
+		if (!v || !v->Valid(u, this->generation))
+		{
+			IgnoreData *ign = this->Match(u);
+			v = this->verdicts.Set(u);
+			v->Set(u, this->generation, ign);
+		}
+
+		/* Expiring the ignore changes the generation, so the verdict is redone next time */
+		if (v->ign && CheckExpire(v->ign))
+			return NULL;
+		return v->ign;
+	}
+
 	IgnoreData *Find(const Anope::string &mask) anope_override
 	{
 		User *u = User::Find(mask, true);
-		std::vector<IgnoreData *>::iterator ign = this->ignores->begin(), ign_end = this->ignores->end();
-
 		if (u)
+			return this->Find(u);
+
+		size_t user, host;
+		Anope::string tmp;
+		/* We didn't get a user.. generate a valid mask. */
+		if ((host = mask.find('@')) != Anope::string::npos)
 		{
-			for (; ign != ign_end; ++ign)
+			if ((user = mask.find('!')) != Anope::string::npos)
 			{
-				Entry ignore_mask("", (*ign)->mask);
-				if (ignore_mask.Matches(u, true))
-					break;
+				/* this should never happen */
+				if (user > host)
+					return NULL;
+				tmp = mask;
 			}
+			else
+				/* We have user@host. Add nick wildcard. */
+			tmp = "*!" + mask;
 		}
+		/* We only got a nick.. */
 		else
-		{
-			size_t user, host;
-			Anope::string tmp;
-			/* We didn't get a user.. generate a valid mask. */
-			if ((host = mask.find('@')) != Anope::string::npos)
-			{
-				if ((user = mask.find('!')) != Anope::string::npos)
-				{
-					/* this should never happen */
-					if (user > host)
-						return NULL;
-					tmp = mask;
-				}
-				else
-					/* We have user@host. Add nick wildcard. */
-				tmp = "*!" + mask;
-			}
-			/* We only got a nick.. */
-			else
-				tmp = mask + "!*@*";
+			tmp = mask + "!*@*";
 
-			for (; ign != ign_end; ++ign)
-				if (Anope::Match(tmp, (*ign)->mask, false, true))
-					break;
-		}
+		for (std::vector<IgnoreData *>::iterator ign = this->ignores->begin(), ign_end = this->ignores->end(); ign != ign_end; ++ign)
+			if (Anope::Match(tmp, (*ign)->mask, false, true))
+				return CheckExpire(*ign) ? NULL : *ign;
 
-		/* Check whether the entry has timed out */
-		if (ign != ign_end)
-		{
-			IgnoreData *id = *ign;
+		return NULL;
+	}
 
-			if (id->time && !Anope::NoExpire && id->time <= Anope::CurTime)
-			{
-				Log(LOG_NORMAL, "expire/ignore", Config->GetClient("OperServ")) << "Expiring ignore entry " << id->mask;
-				delete id;
-			}
-			else
-				return id;
-		}
+	/** Delete ignores which have expired
+	 */
+	void Expire()
+	{
+		if (Anope::NoExpire)
+			return;
 
-		return NULL;
+		IgnoreData *ign;
+		while (this->expiries.Next(Anope::CurTime, ign))
+			if (!CheckExpire(ign) && ign->time)
+				this->expiries.Schedule(ign, ign->time);
 	}
 
 	std::vector<IgnoreData *> &GetIgnores() anope_override
 	{
+		/* The caller may change the list */
+		this->Changed();
 		return *ignores;
 	}
 };
@@ -406,11 +595,16 @@ class OSIgnore : public Module
 
 	EventReturn OnBotPrivmsg(User *u, BotInfo *bi, Anope::string &message) anope_override
 	{
-		if (!u->HasMode("OPER") && this->osignoreservice.Find(u->nick))
+		if (!u->HasMode("OPER") && this->osignoreservice.Find(u))
 			return EVENT_STOP;
 
 		return EVENT_CONTINUE;
 	}
+
+	void OnExpireTick() anope_override
+	{
+		this->osignoreservice.Expire();
+	}
 };
 
 MODULE_INIT(OSIgnore)
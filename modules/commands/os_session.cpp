@@ -39,8 +39,99 @@ class MySessionService : public SessionService
 {
 	SessionMap Sessions;
 	Serialize::Checker<ExceptionVector> Exceptions;
+	/* Exceptions with an expiry, by when they expire */
+	ExpiryQueue<Exception *> expiries;
+
+	typedef TR1NS::unordered_multimap<Anope::string, Exception *, Anope::hash_ci, Anope::compare> host_map;
+
+	/* Exceptions without wildcards, by mask */
+	host_map exception_hosts;
+	/* Exceptions which are an IP or CIDR range */
+	CIDRTree<Exception *> exception_ranges;
+	/* Exceptions with wildcards, which every host has to be checked against, in list order */
+	std::vector<Exception *> exception_others;
+	/* Where each exception is in the list */
+	TR1NS::unordered_map<Exception *, size_t> exception_positions;
+	/* Whether the list has changed since the above were built */
+	bool exceptions_changed;
+
+	void BuildExceptionIndex()
+	{
+		const ExceptionVector &exceptions = *this->Exceptions;
+
+		if (!this->exceptions_changed && this->exception_positions.size() == exceptions.size())
+			return;
+
+		this->exception_hosts.clear();
+		this->exception_ranges.clear();
+		this->exception_others.clear();
+		this->exception_positions.clear();
+
+		for (size_t i = 0; i < exceptions.size(); ++i)
+		{
+			Exception *e = exceptions[i];
+			this->exception_positions[e] = i;
+
+			if (e->mask.find_first_of("*?") != Anope::string::npos)
+			{
+				this->exception_others.push_back(e);
+				continue;
+			}
+
+			this->exception_hosts.insert(std::make_pair(e->mask, e));
+
+			cidr range(e->mask);
+			if (range.valid())
+				this->exception_ranges.insert(range, e);
+		}
+
+		this->exceptions_changed = false;
+	}
+
+	/* Finds the first exception in the list which matches any of the hosts or the IP */
+	Exception *FindException(const Anope::string *hosts[], unsigned count, const sockaddrs &ip)
+	{
+		this->BuildExceptionIndex();
+
+		Exception *best = NULL;
+		size_t best_pos = 0;
+
+		std::vector<Exception *> candidates;
+		for (unsigned i = 0; i < count; ++i)
+		{
+			std::pair<host_map::const_iterator, host_map::const_iterator> range = this->exception_hosts.equal_range(*hosts[i]);
+			for (host_map::const_iterator it = range.first; it != range.second; ++it)
+				candidates.push_back(it->second);
+		}
+		this->exception_ranges.find(ip, candidates);
+
+		for (unsigned i = 0; i < candidates.size(); ++i)
+		{
+			size_t pos = this->exception_positions[candidates[i]];
+			if (!best || pos < best_pos)
+			{
+				best = candidates[i];
+				best_pos = pos;
+			}
+		}
+
+		/* A wildcard exception earlier in the list takes precedence */
+		for (unsigned i = 0; i < this->exception_others.size(); ++i)
+		{
+			Exception *e = this->exception_others[i];
+			if (best && this->exception_positions[e] > best_pos)
+				break;
+
+			for (unsigned j = 0; j < count; ++j)
+				if (Anope::Match(*hosts[j], e->mask))
+					return e;
+		}
+
+		return best;
+	}
+
  public:
-	MySessionService(Module *m) : SessionService(m), Exceptions("Exception") { }
+	MySessionService(Module *m) : SessionService(m), Exceptions("Exception"), exceptions_changed(true) { }
 
 	Exception *CreateException() anope_override
 	{
@@ -50,6 +141,9 @@ class MySessionService : public SessionService
 	void AddException(Exception *e) anope_override
 	{
 		this->Exceptions->push_back(e);
+		this->exceptions_changed = true;
+		if (e->expires)
+			this->expiries.Schedule(e, e->expires);
 	}
 
 	void DelException(Exception *e) anope_override
@@ -57,39 +151,52 @@ class MySessionService : public SessionService
 		ExceptionVector::iterator it = std::find(this->Exceptions->begin(), this->Exceptions->end(), e);
 		if (it != this->Exceptions->end())
 			this->Exceptions->erase(it);
+		this->exceptions_changed = true;
+		this->expiries.Unschedule(e);
 	}
 
-	Exception *FindException(User *u) anope_override
+	void UpdateException(Exception *e) anope_override
 	{
-		for (std::vector<Exception *>::const_iterator it = this->Exceptions->begin(), it_end = this->Exceptions->end(); it != it_end; ++it)
-		{
-			Exception *e = *it;
-			if (Anope::Match(u->host, e->mask) || Anope::Match(u->ip.addr(), e->mask))
-				return e;
+		this->exceptions_changed = true;
+		/* An expiry which has been moved later is scheduled again when the earlier one is reached */
+		if (e->expires)
+			this->expiries.Schedule(e, e->expires);
+	}
 
-			if (cidr(e->mask).match(u->ip))
+	/** Get the next exception which has expired
+	 * @return The exception, or NULL if none have
+	 */
+	Exception *NextExpired()
+	{
+		Exception *e;
+		while (this->expiries.Next(Anope::CurTime, e))
+		{
+			if (e->expires && e->expires <= Anope::CurTime)
 				return e;
+			/* The expiry has been changed since this was scheduled */
+			else if (e->expires)
+				this->expiries.Schedule(e, e->expires);
 		}
 		return NULL;
 	}
 
-	Exception *FindException(const Anope::string &host) anope_override
+	Exception *FindException(User *u) anope_override
 	{
-		for (std::vector<Exception *>::const_iterator it = this->Exceptions->begin(), it_end = this->Exceptions->end(); it != it_end; ++it)
-		{
-			Exception *e = *it;
-			if (Anope::Match(host, e->mask))
-				return e;
-
-			if (cidr(e->mask).match(sockaddrs(host)))
-				return e;
-		}
+		const Anope::string ip = u->ip.addr();
+		const Anope::string *hosts[] = { &u->host, &ip };
+		return this->FindException(hosts, 2, u->ip);
+	}
 
-		return NULL;
+	Exception *FindException(const Anope::string &host) anope_override
+	{
+		const Anope::string *hosts[] = { &host };
+		return this->FindException(hosts, 1, sockaddrs(host));
 	}
 
 	ExceptionVector &GetExceptions() anope_override
 	{
+		/* The caller may reorder or change the list */
+		this->exceptions_changed = true;
 		return this->Exceptions;
 	}
 
@@ -354,6 +461,7 @@ class CommandOSException : public Command
 				{
 					if (e->limit != limit)
 					{
+						e->QueueUpdate();
 						e->limit = limit;
 						source.Reply(_("Exception for \002%s\002 has been updated to %d."), mask.c_str(), e->limit);
 					}
@@ -720,12 +828,13 @@ class OSSession : public Module
 	{
 		if (Anope::NoExpire)
 			return;
-		for (unsigned i = this->ss.GetExceptions().size(); i > 0; --i)
-		{
-			Exception *e = this->ss.GetExceptions()[i - 1];
 
-			if (!e->expires || e->expires > Anope::CurTime)
-				continue;
+		/* The most exceptions expired in one tick */
+		static const unsigned MaxExpires = 10000;
+
+		Exception *e;
+		for (unsigned i = 0; i < MaxExpires && (e = this->ss.NextExpired()); ++i)
+		{
 			BotInfo *OperServ = Config->GetClient("OperServ");
 			Log(OperServ, "expire/exception") << "Session exception for " << e->mask << " has expired.";
 			this->ss.DelException(e);
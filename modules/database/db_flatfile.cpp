@@ -11,107 +11,1729 @@
 
 #include "module.h"
 
+#include <sys/types.h>
+#include <sys/stat.h>
 #ifndef _WIN32
 #include <sys/wait.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #endif
 
+/* The number of characters needed to format any 64 bit number */
+static const size_t IntLength = 20;
+
+/** Formats a number without going through a stream
+ * @param buf Where to format the number, which ends at buf + IntLength
+ * @return Where the number starts
+ */
+static const char *FormatInt(char *buf, int64_t value)
+{
+	char *p = buf + IntLength;
+	uint64_t v = value < 0 ? 0 - static_cast<uint64_t>(value) : value;
+
+	do
+		*--p = '0' + v % 10;
+	while (v /= 10);
+
+	if (value < 0)
+		*--p = '-';
+	return p;
+}
+
+/** Parses a number without going through a stream, the same way reading it from one does
+ * @return false if the value does not start with a number
+ */
+static bool ParseInt(const char *str, size_t len, int64_t &value)
+{
+	const char *end = str + len;
+
+	value = 0;
+	while (str != end && (*str == ' ' || *str == '\t'))
+		++str;
+
+	bool negative = str != end && *str == '-';
+	if (str != end && (*str == '-' || *str == '+'))
+		++str;
+	if (str == end || *str < '0' || *str > '9')
+		return false;
+
+	uint64_t v = 0;
+	for (; str != end && *str >= '0' && *str <= '9'; ++str)
+		v = v * 10 + (*str - '0');
+
+	value = negative ? 0 - v : v;
+	return true;
+}
+
 class SaveData : public Serialize::Data
 {
+	std::iostream &Field(const Anope::string &key)
+	{
+		if (key != last)
+		{
+			*fs << "\nDATA " << key << " ";
+			last = key;
+		}
+
+		return *fs;
+	}
+
  public:
  	Anope::string last;
 	std::fstream *fs;
 
-	SaveData() : fs(NULL) { }
+	SaveData() : fs(NULL) { }
+
+	std::iostream& operator[](const Anope::string &key) anope_override
+	{
+		return this->Field(key);
+	}
+
+	void Set(const Serialize::Key &key, int64_t value) anope_override
+	{
+		char buf[IntLength];
+		const char *p = FormatInt(buf, value);
+		this->Field(key.GetName()).write(p, buf + IntLength - p);
+	}
+
+	void Set(const Serialize::Key &key, const Anope::string &value) anope_override
+	{
+		this->Field(key.GetName()).write(value.c_str(), value.length());
+	}
+};
+
+class LoadData : public Serialize::Data
+{
+ public:
+	unsigned int id;
+	std::map<Anope::string, Anope::string> data;
+	std::stringstream ss;
+
+	LoadData() : id(0) { }
+
+	std::iostream& operator[](const Anope::string &key) anope_override
+	{
+		ss.clear();
+		this->ss << this->data[key];
+		return this->ss;
+	}
+
+	bool Get(const Serialize::Key &key, int64_t &value) anope_override
+	{
+		std::map<Anope::string, Anope::string>::const_iterator it = this->data.find(key.GetName());
+		if (it == this->data.end())
+		{
+			value = 0;
+			return false;
+		}
+
+		return ParseInt(it->second.c_str(), it->second.length(), value);
+	}
+
+	bool Get(const Serialize::Key &key, Anope::string &value) anope_override
+	{
+		std::map<Anope::string, Anope::string>::const_iterator it = this->data.find(key.GetName());
+		if (it == this->data.end())
+		{
+			value.clear();
+			return false;
+		}
+
+		value = it->second;
+		return !value.empty();
+	}
+
+	std::set<Anope::string> KeySet() const anope_override
+	{
+		std::set<Anope::string> keys;
+		for (std::map<Anope::string, Anope::string>::const_iterator it = this->data.begin(), it_end = this->data.end(); it != it_end; ++it)
+			keys.insert(it->first);
+		return keys;
+	}
+
+	size_t Hash() const anope_override
+	{
+		size_t hash = 0;
+		for (std::map<Anope::string, Anope::string>::const_iterator it = this->data.begin(), it_end = this->data.end(); it != it_end; ++it)
+			if (!it->second.empty())
+				hash ^= Anope::hash_cs()(it->second);
+		return hash;
+	}
+
+	void Reset()
+	{
+		id = 0;
+		data.clear();
+	}
+};
+
+/* The binary database format is made of:
+ *
+ * A header, "ANOPEBIN" followed by the format version.
+ * The objects, each made of the index of its type, its id, its number of fields and then
+ *   the fields. A field is the index of its key in its type's key names, the length of its
+ *   value and then the value.
+ * The type table, which for each type has its name, the names of its keys, and the offsets
+ *   of its objects in the file.
+ * A trailer, made of the offset of the type table followed by "ANOPEIDX".
+ *
+ * Numbers are little endian, and strings are prefixed with their 32 bit length.
+ */
+static const char BinaryMagic[] = "ANOPEBIN", IndexMagic[] = "ANOPEIDX";
+static const size_t MagicLength = 8;
+static const uint32_t BinaryVersion = 1;
+
+static void WriteInt(std::string &buf, uint64_t value, unsigned bytes)
+{
+	for (unsigned i = 0; i < bytes; ++i)
+		buf += static_cast<char>((value >> (i * 8)) & 0xFF);
+}
+
+static void WriteString(std::string &buf, const Anope::string &str)
+{
+	WriteInt(buf, str.length(), 4);
+	buf += str.str();
+}
+
+/* A database file mapped into memory, or read into memory if it can not be mapped */
+class MappedFile
+{
+	const char *data;
+	size_t size;
+	/* Whether data is mapped, rather than in buffer */
+	bool mapped;
+	std::vector<char> buffer;
+
+	bool Read(const Anope::string &filename)
+	{
+		std::ifstream fs(filename.c_str(), std::ios_base::in | std::ios_base::binary);
+		if (!fs.is_open())
+			return false;
+
+		char buf[65536];
+		while (fs.read(buf, sizeof(buf)) || fs.gcount())
+			this->buffer.insert(this->buffer.end(), buf, buf + fs.gcount());
+		if (fs.bad())
+		{
+			this->buffer.clear();
+			return false;
+		}
+
+		this->data = this->buffer.empty() ? NULL : &this->buffer[0];
+		this->size = this->buffer.size();
+		return true;
+	}
+
+ public:
+	MappedFile() : data(NULL), size(0), mapped(false) { }
+
+	~MappedFile()
+	{
+		this->Close();
+	}
+
+	/** Opens a file. An empty file opens with no data.
+	 * @return false if the file can not be read
+	 */
+	bool Open(const Anope::string &filename)
+	{
+		this->Close();
+
+#ifndef _WIN32
+		int fd = open(filename.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+
+		struct stat st;
+		if (fstat(fd, &st) < 0)
+		{
+			close(fd);
+			return false;
+		}
+
+		if (st.st_size == 0)
+		{
+			close(fd);
+			return true;
+		}
+
+		void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (map == MAP_FAILED)
+			return this->Read(filename);
+
+		/* Types are loaded one at a time, so objects are not read in order */
+		madvise(map, st.st_size, MADV_WILLNEED);
+
+		this->data = static_cast<const char *>(map);
+		this->size = st.st_size;
+		this->mapped = true;
+		return true;
+#else
+		return this->Read(filename);
+#endif
+	}
+
+	void Close()
+	{
+#ifndef _WIN32
+		if (this->mapped)
+			munmap(const_cast<char *>(this->data), this->size);
+#endif
+		this->buffer.clear();
+		this->data = NULL;
+		this->size = 0;
+		this->mapped = false;
+	}
+
+	const char *GetData() const { return this->data; }
+	size_t GetSize() const { return this->size; }
+};
+
+/* Reads numbers and strings from part of a mapped file */
+class BinaryReader
+{
+	const char *pos, *end;
+
+ public:
+	BinaryReader(const char *b, const char *e) : pos(b), end(e) { }
+
+	bool ReadInt(uint64_t &value, unsigned bytes)
+	{
+		if (static_cast<size_t>(this->end - this->pos) < bytes)
+			return false;
+
+		value = 0;
+		for (unsigned i = 0; i < bytes; ++i)
+			value |= static_cast<uint64_t>(static_cast<unsigned char>(this->pos[i])) << (i * 8);
+		this->pos += bytes;
+		return true;
+	}
+
+	bool ReadBytes(const char *&str, uint64_t len)
+	{
+		if (static_cast<uint64_t>(this->end - this->pos) < len)
+			return false;
+
+		str = this->pos;
+		this->pos += len;
+		return true;
+	}
+
+	bool ReadString(Anope::string &str)
+	{
+		uint64_t len;
+		const char *s;
+		if (!this->ReadInt(len, 4) || !this->ReadBytes(s, len))
+			return false;
+
+		str = Anope::string(s, s + len);
+		return true;
+	}
+};
+
+/* A binary database, and the index of the objects in it */
+class BinaryDatabase
+{
+	MappedFile file;
+
+ public:
+	struct TypeIndex
+	{
+		Anope::string name;
+		/* The position of this type in the type table, objects refer to their type by it */
+		unsigned pos;
+		/* Key names, and their positions in the key table */
+		std::map<Anope::string, unsigned> keys;
+		/* The offsets of this type's objects */
+		const char *offsets;
+		uint64_t count;
+	};
+
+	std::map<Anope::string, TypeIndex> types;
+
+	/** Opens and indexes a database
+	 * @param filename The file to open
+	 * @param error Set to the reason when the file is a corrupt binary database
+	 * @return true if the file is a binary database
+	 */
+	bool Open(const Anope::string &filename, Anope::string &error)
+	{
+		if (!this->file.Open(filename))
+			return false;
+
+		const char *data = this->file.GetData();
+		size_t size = this->file.GetSize();
+
+		if (size < MagicLength || memcmp(data, BinaryMagic, MagicLength))
+		{
+			this->file.Close();
+			return false;
+		}
+
+		BinaryReader header(data + MagicLength, data + size);
+		uint64_t version;
+		if (!header.ReadInt(version, 4) || version != BinaryVersion)
+		{
+			error = "unknown format version";
+			return true;
+		}
+
+		BinaryReader trailer(data + size - std::min(size, static_cast<size_t>(8 + MagicLength)), data + size);
+		uint64_t table_offset;
+		const char *magic;
+		if (!trailer.ReadInt(table_offset, 8) || !trailer.ReadBytes(magic, MagicLength) || memcmp(magic, IndexMagic, MagicLength) || table_offset > size)
+		{
+			error = "missing or corrupt object index, the file may be truncated";
+			return true;
+		}
+
+		BinaryReader table(data + table_offset, data + size);
+		uint64_t type_count;
+		if (!table.ReadInt(type_count, 4))
+		{
+			error = "corrupt object index";
+			return true;
+		}
+
+		for (unsigned i = 0; i < type_count; ++i)
+		{
+			Anope::string name;
+			uint64_t key_count;
+			if (!table.ReadString(name) || !table.ReadInt(key_count, 4))
+			{
+				error = "corrupt object index";
+				return true;
+			}
+
+			TypeIndex &type = this->types[name];
+			type.name = name;
+			type.pos = i;
+
+			for (unsigned j = 0; j < key_count; ++j)
+			{
+				Anope::string key;
+				if (!table.ReadString(key))
+				{
+					error = "corrupt object index";
+					return true;
+				}
+				type.keys[key] = j;
+			}
+
+			if (!table.ReadInt(type.count, 8) || type.count > size / 8 || !table.ReadBytes(type.offsets, type.count * 8))
+			{
+				error = "corrupt object index";
+				return true;
+			}
+		}
+
+		return true;
+	}
+
+	const TypeIndex *Find(const Anope::string &name) const
+	{
+		std::map<Anope::string, TypeIndex>::const_iterator it = this->types.find(name);
+		if (it != this->types.end())
+			return &it->second;
+		return NULL;
+	}
+
+	const char *GetData() const { return this->file.GetData(); }
+	size_t GetSize() const { return this->file.GetSize(); }
+};
+
+/* A read only stream buffer over a value in a mapped file */
+class ValueBuffer : public std::streambuf
+{
+ public:
+	void Set(const char *value, size_t len)
+	{
+		char *v = const_cast<char *>(value);
+		this->setg(v, v, v + len);
+	}
+};
+
+class BinaryLoadData : public Serialize::Data
+{
+	const BinaryDatabase::TypeIndex *type;
+	/* The values of the current object, by the position of their key */
+	std::vector<std::pair<const char *, size_t> > values;
+	ValueBuffer buf;
+	std::iostream stream;
+	/* The positions of the type's keys by key id, -1 if the type has no such key and -2 if not yet looked up */
+	std::vector<int> positions;
+	const BinaryDatabase::TypeIndex *positions_type;
+
+	/** Finds the value of a field
+	 * @return false if the object has no value for it
+	 */
+	bool Find(const Serialize::Key &key, const char *&value, size_t &len)
+	{
+		if (this->positions_type != this->type)
+		{
+			this->positions.assign(Serialize::Key::GetCount(), -2);
+			this->positions_type = this->type;
+		}
+		if (key.GetId() >= this->positions.size())
+			this->positions.resize(key.GetId() + 1, -2);
+
+		int &pos = this->positions[key.GetId()];
+		if (pos == -2)
+		{
+			std::map<Anope::string, unsigned>::const_iterator it = this->type->keys.find(key.GetName());
+			pos = it != this->type->keys.end() ? it->second : -1;
+		}
+
+		if (pos < 0 || !this->values[pos].first)
+			return false;
+
+		value = this->values[pos].first;
+		len = this->values[pos].second;
+		return true;
+	}
+
+ public:
+	uint64_t id;
+
+	BinaryLoadData() : type(NULL), stream(&buf), positions_type(NULL), id(0) { }
+
+	/** Reads an object
+	 * @param db The database
+	 * @param t The type of the object
+	 * @param n Which of the type's objects to read
+	 * @return false if the object is corrupt
+	 */
+	bool Read(const BinaryDatabase &db, const BinaryDatabase::TypeIndex &t, uint64_t n)
+	{
+		this->type = &t;
+		this->values.assign(t.keys.size(), std::make_pair(static_cast<const char *>(NULL), 0));
+
+		uint64_t offset;
+		BinaryReader index(t.offsets + n * 8, t.offsets + (n + 1) * 8);
+		if (!index.ReadInt(offset, 8) || offset >= db.GetSize())
+			return false;
+
+		BinaryReader object(db.GetData() + offset, db.GetData() + db.GetSize());
+		uint64_t type_pos, field_count;
+		if (!object.ReadInt(type_pos, 4) || type_pos != t.pos || !object.ReadInt(this->id, 8) || !object.ReadInt(field_count, 4))
+			return false;
+
+		for (uint64_t i = 0; i < field_count; ++i)
+		{
+			uint64_t key, len;
+			const char *value;
+			if (!object.ReadInt(key, 4) || key >= this->values.size() || !object.ReadInt(len, 4) || !object.ReadBytes(value, len))
+				return false;
+
+			this->values[key] = std::make_pair(value, len);
+		}
+
+		return true;
+	}
+
+	std::iostream& operator[](const Anope::string &key) anope_override
+	{
+		std::map<Anope::string, unsigned>::const_iterator it = this->type->keys.find(key);
+		if (it != this->type->keys.end())
+			this->buf.Set(this->values[it->second].first, this->values[it->second].second);
+		else
+			this->buf.Set(NULL, 0);
+
+		this->stream.clear();
+		return this->stream;
+	}
+
+	bool Get(const Serialize::Key &key, int64_t &value) anope_override
+	{
+		const char *v;
+		size_t len;
+		if (!this->Find(key, v, len))
+		{
+			value = 0;
+			return false;
+		}
+
+		return ParseInt(v, len, value);
+	}
+
+	bool Get(const Serialize::Key &key, Anope::string &value) anope_override
+	{
+		const char *v;
+		size_t len;
+		if (!this->Find(key, v, len))
+		{
+			value.clear();
+			return false;
+		}
+
+		value.str().assign(v, len);
+		return len > 0;
+	}
+
+	std::set<Anope::string> KeySet() const anope_override
+	{
+		std::set<Anope::string> keys;
+		for (std::map<Anope::string, unsigned>::const_iterator it = this->type->keys.begin(), it_end = this->type->keys.end(); it != it_end; ++it)
+			if (this->values[it->second].first)
+				keys.insert(it->first);
+		return keys;
+	}
+
+	size_t Hash() const anope_override
+	{
+		size_t hash = 0;
+		for (unsigned i = 0; i < this->values.size(); ++i)
+			if (this->values[i].second)
+				hash ^= Anope::hash_cs()(Anope::string(this->values[i].first, this->values[i].first + this->values[i].second));
+		return hash;
+	}
+};
+
+/* Writes a binary database */
+class BinaryWriter
+{
+	struct TypeTable
+	{
+		unsigned pos;
+		std::map<Anope::string, unsigned> keys;
+		std::vector<Anope::string> key_names;
+		std::vector<uint64_t> offsets;
+	};
+
+	std::ostream *fs;
+	/* Types are referred to by name, so the writer can be used without them by the snapshot writer thread */
+	std::vector<Anope::string> types;
+	std::map<Anope::string, TypeTable> tables;
+	uint64_t offset;
+	/* The record of the object being written, and its fields */
+	std::string record, fields;
+
+ public:
+	BinaryWriter(std::ostream *f) : fs(f), offset(0)
+	{
+		std::string header(BinaryMagic, MagicLength);
+		WriteInt(header, BinaryVersion, 4);
+		this->Write(header);
+	}
+
+	void Write(const std::string &buf)
+	{
+		this->fs->write(buf.data(), buf.length());
+		this->offset += buf.length();
+	}
+
+	TypeTable &GetTable(const Anope::string &type)
+	{
+		std::map<Anope::string, TypeTable>::iterator it = this->tables.find(type);
+		if (it != this->tables.end())
+			return it->second;
+
+		TypeTable &table = this->tables[type];
+		table.pos = this->types.size();
+		this->types.push_back(type);
+		return table;
+	}
+
+	void AddField(const Anope::string &type, const Anope::string &key, const std::string &value)
+	{
+		TypeTable &table = this->GetTable(type);
+
+		std::map<Anope::string, unsigned>::iterator it = table.keys.find(key);
+		if (it == table.keys.end())
+		{
+			it = table.keys.insert(std::make_pair(key, table.key_names.size())).first;
+			table.key_names.push_back(key);
+		}
+
+		WriteInt(this->fields, it->second, 4);
+		WriteInt(this->fields, value.length(), 4);
+		this->fields += value;
+	}
+
+	void WriteObject(const Anope::string &type, uint64_t id, unsigned field_count)
+	{
+		TypeTable &table = this->GetTable(type);
+		table.offsets.push_back(this->offset);
+
+		this->record.clear();
+		WriteInt(this->record, table.pos, 4);
+		WriteInt(this->record, id, 8);
+		WriteInt(this->record, field_count, 4);
+		this->Write(this->record);
+		this->Write(this->fields);
+
+		this->fields.clear();
+	}
+
+	/* Writes the type table and trailer, after every object has been written */
+	void Finish()
+	{
+		uint64_t table_offset = this->offset;
+
+		this->record.clear();
+		WriteInt(this->record, this->types.size(), 4);
+		for (unsigned i = 0; i < this->types.size(); ++i)
+		{
+			const TypeTable &table = this->tables[this->types[i]];
+
+			WriteString(this->record, this->types[i]);
+			WriteInt(this->record, table.key_names.size(), 4);
+			for (unsigned j = 0; j < table.key_names.size(); ++j)
+				WriteString(this->record, table.key_names[j]);
+
+			WriteInt(this->record, table.offsets.size(), 8);
+			for (unsigned j = 0; j < table.offsets.size(); ++j)
+				WriteInt(this->record, table.offsets[j], 8);
+		}
+
+		WriteInt(this->record, table_offset, 8);
+		this->record.append(IndexMagic, MagicLength);
+		this->Write(this->record);
+	}
+};
+
+class BinarySaveData : public Serialize::Data
+{
+	BinaryWriter *writer;
+	Anope::string type;
+	Anope::string last;
+	std::stringstream value;
+	unsigned field_count;
+
+	void Flush()
+	{
+		if (this->last.empty())
+			return;
+
+		this->writer->AddField(this->type, this->last, this->value.str());
+		++this->field_count;
+
+		this->last.clear();
+		this->value.str("");
+		this->value.clear();
+	}
+
+	void Add(const Anope::string &key, const std::string &v)
+	{
+		this->Flush();
+		this->writer->AddField(this->type, key, v);
+		++this->field_count;
+	}
+
+ public:
+	BinarySaveData() : writer(NULL), field_count(0) { }
+
+	void Save(BinaryWriter *w, Serializable *obj)
+	{
+		this->writer = w;
+		this->type = obj->GetSerializableType()->GetName();
+		this->field_count = 0;
+
+		obj->Serialize(*this);
+		this->Flush();
+
+		this->writer->WriteObject(this->type, obj->id, this->field_count);
+	}
+
+	std::iostream& operator[](const Anope::string &key) anope_override
+	{
+		if (key != this->last)
+		{
+			this->Flush();
+			this->last = key;
+		}
+
+		return this->value;
+	}
+
+	void Set(const Serialize::Key &key, int64_t v) anope_override
+	{
+		char buf[IntLength];
+		const char *p = FormatInt(buf, v);
+		this->Add(key.GetName(), std::string(p, buf + IntLength - p));
+	}
+
+	void Set(const Serialize::Key &key, const Anope::string &v) anope_override
+	{
+		this->Add(key.GetName(), v.str());
+	}
+};
+
+/* A field of an object in a text database, pointing into the mapped file */
+struct TextField
+{
+	const char *key;
+	/* The value follows the key and a space */
+	uint32_t key_len, value_len;
+};
+
+/* An object in a text database, pointing into the mapped file */
+struct TextRecord
+{
+	const char *type;
+	size_t type_len;
+	unsigned int id;
+	/* Set once every record of the part of the database it is in has been parsed */
+	const TextField *fields;
+	size_t first_field, field_count;
+};
+
+/** Parses part of a text database into records. Only touches the mapped file
+ * and its own records, so parts of a database can be parsed at the same time.
+ */
+class TextParseThread : public Thread
+{
+	const char *begin, *end;
+
+ public:
+	std::vector<TextRecord> records;
+	std::vector<TextField> fields;
+
+	TextParseThread(const char *b, const char *e) : begin(b), end(e) { }
+
+	void Run() anope_override
+	{
+		TextRecord *record = NULL;
+
+		for (const char *line = this->begin; line < this->end;)
+		{
+			const char *eol = static_cast<const char *>(memchr(line, '\n', this->end - line));
+			if (eol == NULL)
+				eol = this->end;
+			size_t len = eol - line;
+
+			if (record && len >= 5 && !memcmp(line, "DATA ", 5))
+			{
+				const char *sp = static_cast<const char *>(memchr(line + 5, ' ', len - 5));
+				if (sp != NULL)
+				{
+					TextField field;
+					field.key = line + 5;
+					field.key_len = sp - field.key;
+					field.value_len = eol - sp - 1;
+					this->fields.push_back(field);
+					++record->field_count;
+				}
+			}
+			else if (record && len >= 3 && !memcmp(line, "ID ", 3))
+			{
+				unsigned int id = 0;
+				const char *p = line + 3;
+				for (; p < eol && *p >= '0' && *p <= '9'; ++p)
+					id = id * 10 + (*p - '0');
+				if (p == eol && p > line + 3)
+					record->id = id;
+			}
+			else if (len >= 7 && !memcmp(line, "OBJECT ", 7))
+			{
+				TextRecord r;
+				r.type = line + 7;
+				r.type_len = len - 7;
+				r.id = 0;
+				r.fields = NULL;
+				r.first_field = this->fields.size();
+				r.field_count = 0;
+				this->records.push_back(r);
+				record = &this->records.back();
+			}
+			else if (len == 3 && !memcmp(line, "END", 3))
+				record = NULL;
+			/* Anything else is skipped, without ending the object */
+
+			line = eol + 1;
+		}
+
+		for (unsigned i = 0; i < this->records.size(); ++i)
+			this->records[i].fields = this->fields.empty() ? NULL : &this->fields[this->records[i].first_field];
+	}
+};
+
+class TextLoadData : public Serialize::Data
+{
+	const TextRecord *record;
+	ValueBuffer buf;
+	std::iostream stream;
+
+	const TextField *Find(const Anope::string &key) const
+	{
+		/* If a key is given more than once, the last value is used */
+		for (size_t i = this->record->field_count; i > 0; --i)
+		{
+			const TextField &field = this->record->fields[i - 1];
+			if (field.key_len == key.length() && !memcmp(field.key, key.c_str(), field.key_len))
+				return &field;
+		}
+
+		return NULL;
+	}
+
+ public:
+	TextLoadData() : record(NULL), stream(&buf) { }
+
+	void SetRecord(const TextRecord *r)
+	{
+		this->record = r;
+	}
+
+	std::iostream& operator[](const Anope::string &key) anope_override
+	{
+		const TextField *field = this->Find(key);
+		if (field)
+			this->buf.Set(field->key + field->key_len + 1, field->value_len);
+		else
+			this->buf.Set(NULL, 0);
+
+		this->stream.clear();
+		return this->stream;
+	}
+
+	bool Get(const Serialize::Key &key, int64_t &value) anope_override
+	{
+		const TextField *field = this->Find(key.GetName());
+		if (!field)
+		{
+			value = 0;
+			return false;
+		}
+
+		return ParseInt(field->key + field->key_len + 1, field->value_len, value);
+	}
+
+	bool Get(const Serialize::Key &key, Anope::string &value) anope_override
+	{
+		const TextField *field = this->Find(key.GetName());
+		if (!field)
+		{
+			value.clear();
+			return false;
+		}
+
+		value.str().assign(field->key + field->key_len + 1, field->value_len);
+		return field->value_len > 0;
+	}
+
+	std::set<Anope::string> KeySet() const anope_override
+	{
+		std::set<Anope::string> keys;
+		for (size_t i = 0; i < this->record->field_count; ++i)
+			keys.insert(Anope::string(this->record->fields[i].key, this->record->fields[i].key + this->record->fields[i].key_len));
+		return keys;
+	}
+
+	size_t Hash() const anope_override
+	{
+		std::map<Anope::string, Anope::string> values;
+		for (size_t i = 0; i < this->record->field_count; ++i)
+		{
+			const TextField &field = this->record->fields[i];
+			values[Anope::string(field.key, field.key + field.key_len)] = Anope::string(field.key + field.key_len + 1, field.key + field.key_len + 1 + field.value_len);
+		}
+
+		size_t hash = 0;
+		for (std::map<Anope::string, Anope::string>::const_iterator it = values.begin(), it_end = values.end(); it != it_end; ++it)
+			if (!it->second.empty())
+				hash ^= Anope::hash_cs()(it->second);
+		return hash;
+	}
+};
+
+static unsigned GetProcessorCount()
+{
+#ifndef _WIN32
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+#else
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	long count = info.dwNumberOfProcessors;
+#endif
+	return count > 0 ? count : 1;
+}
+
+/* An object as it was when it was last serialized for a snapshot save */
+struct SnapshotRecord
+{
+	Serializable *obj;
+	/* Whether the object has changed since it was serialized */
+	bool changed;
+	/* Copied from the object when the snapshot is taken, as the writer thread can't look at it */
+	Anope::string type;
+	uint64_t id;
+	/* The keys and values of the object's fields, each prefixed with its 32 bit length */
+	std::string fields;
+
+	SnapshotRecord(Serializable *o) : obj(o), changed(true), id(0) { }
+};
+
+class SnapshotData : public Serialize::Data
+{
+	SnapshotRecord *record;
+	Anope::string last;
+	std::stringstream value;
+
+	void Flush()
+	{
+		if (this->last.empty())
+			return;
+
+		const std::string &v = this->value.str();
+		WriteString(this->record->fields, this->last);
+		WriteInt(this->record->fields, v.length(), 4);
+		this->record->fields += v;
+
+		this->last.clear();
+		this->value.str("");
+		this->value.clear();
+	}
+
+ public:
+	SnapshotData() : record(NULL) { }
+
+	void Save(SnapshotRecord *r)
+	{
+		this->record = r;
+		r->type = r->obj->GetSerializableType()->GetName();
+		r->fields.clear();
+
+		r->obj->Serialize(*this);
+		this->Flush();
+	}
+
+	std::iostream& operator[](const Anope::string &key) anope_override
+	{
+		if (key != this->last)
+		{
+			this->Flush();
+			this->last = key;
+		}
+
+		return this->value;
+	}
+
+	void Set(const Serialize::Key &key, int64_t v) anope_override
+	{
+		char buf[IntLength];
+		const char *p = FormatInt(buf, v);
+
+		this->Flush();
+		WriteString(this->record->fields, key.GetName());
+		WriteInt(this->record->fields, buf + IntLength - p, 4);
+		this->record->fields.append(p, buf + IntLength - p);
+	}
+
+	void Set(const Serialize::Key &key, const Anope::string &v) anope_override
+	{
+		this->Flush();
+		WriteString(this->record->fields, key.GetName());
+		WriteString(this->record->fields, v);
+	}
+};
+
+/* A write only stream buffer over a stdio file, so the file can be synced to disk once written */
+class FileBuffer : public std::streambuf
+{
+	FILE *file;
+
+ public:
+	FileBuffer(FILE *f) : file(f) { }
+
+ protected:
+	int overflow(int c) anope_override
+	{
+		if (c != EOF && fputc(c, this->file) == EOF)
+			return EOF;
+		return traits_type::not_eof(c);
+	}
+
+	std::streamsize xsputn(const char *s, std::streamsize n) anope_override
+	{
+		return fwrite(s, 1, n, this->file);
+	}
+};
+
+class DBFlatFile;
+
+/** Writes out the journal on the next loop iteration, once the objects that
+ * were changed are done being changed. The module's own pipe is used by the
+ * child process that saves the databases.
+ */
+class JournalNotifier : public Pipe
+{
+	DBFlatFile *db;
+
+ public:
+	JournalNotifier(DBFlatFile *d) : db(d) { }
+
+	void OnNotify() anope_override;
+};
+
+/** Writes a snapshot of the objects out to the databases, so the main thread
+ * doesn't have to wait on formatting the databases and writing them to disk.
+ */
+class SnapshotWriter : public Thread
+{
+	DBFlatFile *db;
+
+	bool WriteDatabase(const Anope::string &db_name, const std::vector<const SnapshotRecord *> &records)
+	{
+		const Anope::string &tmp_name = db_name + ".tmp";
+		FILE *f = fopen(tmp_name.c_str(), "wb");
+		if (!f)
+			return false;
+
+		FileBuffer buf(f);
+		std::ostream out(&buf);
+		BinaryWriter *writer = this->binary ? new BinaryWriter(&out) : NULL;
+
+		for (unsigned i = 0; i < records.size(); ++i)
+		{
+			const SnapshotRecord *r = records[i];
+			BinaryReader reader(r->fields.data(), r->fields.data() + r->fields.length());
+			unsigned field_count = 0;
+			uint64_t key_len, value_len;
+			const char *key, *value;
+
+			if (!writer)
+			{
+				out << "OBJECT " << r->type;
+				if (r->id)
+					out << "\nID " << r->id;
+			}
+
+			while (reader.ReadInt(key_len, 4) && reader.ReadBytes(key, key_len) && reader.ReadInt(value_len, 4) && reader.ReadBytes(value, value_len))
+			{
+				if (writer)
+					writer->AddField(r->type, Anope::string(key, key + key_len), std::string(value, value_len));
+				else
+				{
+					out << "\nDATA ";
+					out.write(key, key_len);
+					out << " ";
+					out.write(value, value_len);
+				}
+				++field_count;
+			}
+
+			if (writer)
+				writer->WriteObject(r->type, r->id, field_count);
+			else
+				out << "\nEND\n";
+		}
+
+		if (writer)
+		{
+			writer->Finish();
+			delete writer;
+		}
+
+		bool ok = out.good() && !fflush(f);
+#ifndef _WIN32
+		ok = !fsync(fileno(f)) && ok;
+#else
+		ok = !_commit(_fileno(f)) && ok;
+#endif
+		ok = !fclose(f) && ok;
+
+#ifndef _WIN32
+		ok = ok && !rename(tmp_name.c_str(), db_name.c_str());
+#else
+		ok = ok && MoveFileExA(tmp_name.c_str(), db_name.c_str(), MOVEFILE_REPLACE_EXISTING);
+#endif
+		if (!ok)
+			unlink(tmp_name.c_str());
+		return ok;
+	}
+
+ public:
+	/* The databases to write, and the objects in each of them */
+	std::vector<std::pair<Anope::string, std::vector<const SnapshotRecord *> > > databases;
+	bool binary;
+	/* Set by the thread once it is done */
+	std::vector<Anope::string> failed;
+	long write_time;
+
+	SnapshotWriter(DBFlatFile *d, bool b) : db(d), binary(b), write_time(0) { }
+
+	void Run() anope_override
+	{
+		ElapsedTimer timer;
+
+		for (unsigned i = 0; i < this->databases.size(); ++i)
+			if (!this->WriteDatabase(this->databases[i].first, this->databases[i].second))
+				this->failed.push_back(this->databases[i].first);
+
+		this->write_time = timer.Elapsed();
+	}
+
+	void OnNotify() anope_override;
+};
+
+class DBFlatFile : public Module, public Pipe
+{
+	/* Day the last backup was on */
+	int last_day;
+	/* Backup file names */
+	std::map<Anope::string, std::list<Anope::string> > backups;
+	bool loaded;
+
+	int child_pid;
+
+	/* Whether changes are written to the journal between full saves. Decided when the database is loaded */
+	bool journal_enabled;
+	/* The changes made since the database was last fully saved */
+	std::fstream journal;
+	JournalNotifier notifier;
+	/* Objects changed since the journal was last written, in the order they were changed */
+	std::vector<Serializable *> pending;
+	std::set<Serializable *> pending_set;
+	/* Types and ids of objects deleted since the journal was last written */
+	std::vector<std::pair<Anope::string, uint64_t> > deletes;
+	/* Set while the journal is being replayed or written, or while shutting down */
+	bool replaying, flushing, shutting_down;
+	/* When the database was last fully saved in journal mode */
+	time_t last_compaction;
+
+	/* Every object in the order they were created in, and its record, while saving snapshots */
+	std::list<SnapshotRecord *> snapshot;
+	std::map<Serializable *, std::list<SnapshotRecord *>::iterator> snapshot_records;
+	bool snapshot_tracking;
+	/* When every object was last serialized again for a snapshot */
+	time_t last_refresh;
+	/* Writes out the last snapshot taken, if it hasn't finished yet */
+	SnapshotWriter *writer;
+	/* Records of objects destroyed while the writer was running */
+	std::vector<SnapshotRecord *> released;
+	/* Measures the last snapshot save, from when it was taken to when it was written */
+	ElapsedTimer save_timer;
+	long snapshot_pause;
+	size_t snapshot_serialized;
+
+	Anope::string GetJournalName()
+	{
+		return Anope::DataDir + "/" + Config->GetModule(this)->Get<const Anope::string>("database", "anope.db") + ".journal";
+	}
+
+	/** Gives an object the next free id of its type, and indexes it by it */
+	void AssignId(Serializable *obj)
+	{
+		std::map<uint64_t, Serializable *> &objects = obj->GetSerializableType()->objects;
+
+		obj->id = objects.empty() ? 1 : objects.rbegin()->first + 1;
+		objects[obj->id] = obj;
+	}
+
+	/** Indexes loaded objects by their id, so the journal can refer to them. Objects
+	 * without an id, or whose id is taken, are given one in the order they were loaded in.
+	 * @param only If set, only objects of this type are indexed
+	 */
+	void IndexObjects(Serialize::Type *only)
+	{
+		std::vector<Serializable *> unindexed;
+
+		const std::list<Serializable *> &items = Serializable::GetItems();
+		for (std::list<Serializable *>::const_iterator it = items.begin(), it_end = items.end(); it != it_end; ++it)
+		{
+			Serializable *obj = *it;
+			Serialize::Type *stype = obj->GetSerializableType();
+			if (!stype || (only && stype != only))
+				continue;
+
+			if (obj->id)
+			{
+				Serializable *&indexed = stype->objects[obj->id];
+				if (!indexed)
+					indexed = obj;
+				if (indexed == obj)
+					continue;
+			}
+
+			unindexed.push_back(obj);
+		}
+
+		for (unsigned i = 0; i < unindexed.size(); ++i)
+			this->AssignId(unindexed[i]);
+
+		/* Save the new ids with the next save */
+		if (!unindexed.empty())
+			last_compaction = 0;
+	}
+
+	/** Replays the changes recorded in a journal over the loaded objects
+	 * @param journal_file The journal
+	 * @param only If set, only changes to objects of this type are replayed
+	 */
+	void ReplayJournal(const Anope::string &journal_file, Serialize::Type *only)
+	{
+		std::fstream fd(journal_file.c_str(), std::ios_base::in | std::ios_base::binary);
+		if (!fd.is_open())
+			return;
+
+		LoadData ld;
+		unsigned records = 0;
+
+		Anope::string buf;
+		bool have_line = !std::getline(fd, buf.str()).fail();
+		while (have_line)
+		{
+			if (buf.find("DELETE ") == 0)
+			{
+				spacesepstream sep(buf.substr(7));
+				Anope::string type_name, id;
+				sep.GetToken(type_name);
+				sep.GetToken(id);
+
+				Serialize::Type *stype = Serialize::Type::Find(type_name);
+				if (stype && (!only || stype == only))
+				{
+					try
+					{
+						std::map<uint64_t, Serializable *>::iterator it = stype->objects.find(convertTo<uint64_t>(id));
+						if (it != stype->objects.end())
+							delete it->second;
+					}
+					catch (const ConvertException &) { }
+				}
+
+				++records;
+			}
+			else if (buf.find("OBJECT ") == 0)
+			{
+				Serialize::Type *stype = Serialize::Type::Find(buf.substr(7));
+				bool complete = false;
+
+				ld.Reset();
+				while ((have_line = !std::getline(fd, buf.str()).fail()))
+				{
+					if (buf == "END")
+					{
+						complete = true;
+						break;
+					}
+					else if (buf.find("ID ") == 0)
+					{
+						try
+						{
+							ld.id = convertTo<unsigned int>(buf.substr(3));
+						}
+						catch (const ConvertException &) { }
+					}
+					else if (buf.find("DATA ") == 0)
+					{
+						size_t sp = buf.find(' ', 5);
+						if (sp != Anope::string::npos)
+							ld.data[buf.substr(5, sp - 5)] = buf.substr(sp + 1);
+					}
+					else
+						break;
+				}
+
+				/* A record that was being written when services died. Whatever ended it is read again */
+				if (!complete)
+				{
+					Log(this) << "Skipping incomplete record in " << journal_file;
+					continue;
+				}
+
+				if (stype && ld.id && (!only || stype == only))
+				{
+					std::map<uint64_t, Serializable *>::iterator it = stype->objects.find(ld.id);
+
+					Serializable *obj = stype->Unserialize(it != stype->objects.end() ? it->second : NULL, ld);
+					if (obj != NULL)
+					{
+						obj->id = ld.id;
+						stype->objects[obj->id] = obj;
+					}
+				}
+
+				++records;
+			}
+
+			have_line = !std::getline(fd, buf.str()).fail();
+		}
+
+		if (records)
+			Log(this) << "Replayed " << records << " records from " << journal_file;
+	}
+
+	/** Replays the journals over the objects loaded from the database, and opens the journal if it is enabled
+	 * @param only If set, only objects of this type are loaded
+	 */
+	void LoadJournal(Serialize::Type *only)
+	{
+		const Anope::string &journal_name = this->GetJournalName();
+
+		if (!only)
+		{
+			journal_enabled = Config->GetModule(this)->Get<bool>("journal") && !Anope::ReadOnly;
+
+			/* Continue the compaction schedule from when the database was last saved */
+			struct stat st;
+			const Anope::string &db_name = Anope::DataDir + "/" + Config->GetModule(this)->Get<const Anope::string>("database", "anope.db");
+			last_compaction = !stat(db_name.c_str(), &st) ? st.st_mtime : Anope::CurTime;
+		}
+
+		/* Journals are replayed even if they are now disabled, they are removed once the database is next saved */
+		if (!journal_enabled && !Anope::IsFile(journal_name) && !Anope::IsFile(journal_name + ".old"))
+			return;
+
+		this->IndexObjects(only);
+
+		replaying = true;
+		this->ReplayJournal(journal_name + ".old", only);
+		this->ReplayJournal(journal_name, only);
+		replaying = false;
+
+		/* Anything changed while loading is already as it is in the database and journal */
+		std::vector<Serializable *> dirty(Serializable::GetDirtyItems().begin(), Serializable::GetDirtyItems().end());
+		for (unsigned i = 0; i < dirty.size(); ++i)
+			if ((!only || dirty[i]->GetSerializableType() == only) && !pending_set.count(dirty[i]))
+				dirty[i]->Commit();
+
+		if (only || !journal_enabled)
+			return;
+
+		loaded = true;
+
+		/* Finish off the last line if services died while writing it, so it is not merged with the next record */
+		bool torn = false;
+		{
+			std::fstream fd(journal_name.c_str(), std::ios_base::in | std::ios_base::binary);
+			if (fd.is_open() && fd.seekg(-1, std::ios_base::end))
+				torn = fd.get() != '\n';
+		}
+
+		journal.open(journal_name.c_str(), std::ios_base::out | std::ios_base::app | std::ios_base::binary);
+		if (!journal.is_open())
+		{
+			Log(this) << "Unable to open " << journal_name << " for writing, the database will be fully saved instead!";
+			journal_enabled = false;
+			return;
+		}
+
+		if (torn)
+			journal << "\n";
+	}
+
+	/** Moves the journal aside before the database is fully saved. It is removed once the
+	 * save succeeds, and is replayed on startup otherwise.
+	 */
+	void RotateJournal()
+	{
+		const Anope::string &journal_name = this->GetJournalName(), &old_name = journal_name + ".old";
+
+		bool was_open = journal.is_open();
+		if (was_open)
+			journal.close();
+
+		if (Anope::IsFile(journal_name))
+		{
+			if (!Anope::IsFile(old_name))
+				rename(journal_name.c_str(), old_name.c_str());
+			else
+			{
+				/* The last save failed, so the journal from before it is still needed */
+				std::fstream in(journal_name.c_str(), std::ios_base::in | std::ios_base::binary), out(old_name.c_str(), std::ios_base::out | std::ios_base::app | std::ios_base::binary);
+				if (in.is_open() && out.is_open() && in.peek() != EOF)
+					out << in.rdbuf();
+				in.close();
+				out.close();
+
+				unlink(journal_name.c_str());
+			}
+		}
+
+		if (was_open)
+			journal.open(journal_name.c_str(), std::ios_base::out | std::ios_base::app | std::ios_base::binary);
+	}
+
+	/** Keeps a record of an object, to be serialized on the next snapshot save */
+	void TrackSnapshot(Serializable *obj)
+	{
+		snapshot_records[obj] = snapshot.insert(snapshot.end(), new SnapshotRecord(obj));
+	}
+
+	/** Stops keeping records of objects, when snapshot saves are disabled */
+	void ClearSnapshot()
+	{
+		for (std::list<SnapshotRecord *>::iterator it = snapshot.begin(), it_end = snapshot.end(); it != it_end; ++it)
+			delete *it;
+		snapshot.clear();
+		snapshot_records.clear();
+		snapshot_tracking = false;
+	}
+
+	/** Serializes the objects that have changed since the last snapshot, and starts a
+	 * thread to write every object's record out to the databases
+	 */
+	void SaveSnapshot(bool binary)
+	{
+		save_timer.Reset();
+
+		/* Every object is serialized the first time, after that only objects that have changed are */
+		if (!snapshot_tracking)
+		{
+			const std::list<Serializable *> &items = Serializable::GetItems();
+			for (std::list<Serializable *>::const_iterator it = items.begin(), it_end = items.end(); it != it_end; ++it)
+				this->TrackSnapshot(*it);
+			snapshot_tracking = true;
+			last_refresh = Anope::CurTime;
+		}
+		/* Objects changed without being marked as changed would otherwise never be saved, so every
+		 * object is serialized again every so often, and when quitting
+		 */
+		else if (Anope::Quitting || Anope::CurTime - last_refresh >= Config->GetModule(this)->Get<time_t>("snapshotrefresh", "1h"))
+		{
+			for (std::list<SnapshotRecord *>::iterator it = snapshot.begin(), it_end = snapshot.end(); it != it_end; ++it)
+				(*it)->changed = true;
+			last_refresh = Anope::CurTime;
+		}
+
+		writer = new SnapshotWriter(this, binary);
+
+		/* Every registered type's database is written, so the databases of types with no objects are cleared */
+		std::map<Module *, unsigned> positions;
+		for (std::map<Anope::string, Serialize::Type *>::const_iterator it = Serialize::Type::GetTypes().begin(), it_end = Serialize::Type::GetTypes().end(); it != it_end; ++it)
+		{
+			Module *owner = it->second->GetOwner();
+			if (positions.count(owner))
+				continue;
+
+			positions[owner] = writer->databases.size();
+			writer->databases.push_back(std::make_pair(this->GetDatabaseName(owner), std::vector<const SnapshotRecord *>()));
+		}
+
+		SnapshotData data;
+		snapshot_serialized = 0;
+		flushing = true;
+		for (std::list<SnapshotRecord *>::iterator it = snapshot.begin(), it_end = snapshot.end(); it != it_end; ++it)
+		{
+			SnapshotRecord *r = *it;
+			Serialize::Type *s_type = r->obj->GetSerializableType();
+			if (!s_type)
+				continue;
+
+			if (r->changed)
+			{
+				data.Save(r);
+				r->changed = false;
+				++snapshot_serialized;
+			}
+			/* Ids are given out by the journal without the object changing */
+			r->id = r->obj->id;
+
+			writer->databases[positions[s_type->GetOwner()]].second.push_back(r);
+		}
+		flushing = false;
 
-	std::iostream& operator[](const Anope::string &key) anope_override
-	{
-		if (key != last)
+		snapshot_pause = save_timer.Elapsed();
+
+		if (!Anope::Quitting)
 		{
-			*fs << "\nDATA " << key << " ";
-			last = key;
+			try
+			{
+				writer->Start();
+				return;
+			}
+			catch (const CoreException &ex)
+			{
+				Log(this) << ex.GetReason();
+			}
 		}
 
-		return *fs;
+		/* Nothing would be left to wait for the thread when quitting */
+		SnapshotWriter *w = writer;
+		w->Run();
+		this->FinishSnapshot();
+		delete w;
 	}
-};
 
-class LoadData : public Serialize::Data
-{
- public:
- 	std::fstream *fs;
-	unsigned int id;
-	std::map<Anope::string, Anope::string> data;
-	std::stringstream ss;
-	bool read;
+	/** Adds an object to be written to the journal */
+	void QueueJournal(Serializable *obj)
+	{
+		if (!journal.is_open() || replaying || shutting_down || !pending_set.insert(obj).second)
+			return;
 
-	LoadData() : fs(NULL), id(0), read(false) { }
+		if (pending.empty() && deletes.empty())
+			notifier.Notify();
+		pending.push_back(obj);
+	}
 
-	std::iostream& operator[](const Anope::string &key) anope_override
+	/** Loads every object of a type from a binary database
+	 * @return The number of objects in the database
+	 */
+	size_t LoadBinary(const BinaryDatabase &db, Serialize::Type *stype)
 	{
-		if (!read)
+		const BinaryDatabase::TypeIndex *t = db.Find(stype->GetName());
+		if (!t)
+			return 0;
+
+		BinaryLoadData ld;
+		for (uint64_t i = 0; i < t->count; ++i)
 		{
-			for (Anope::string token; std::getline(*this->fs, token.str());)
+			if (!ld.Read(db, *t, i))
 			{
-				if (token.find("ID ") == 0)
-				{
-					try
-					{
-						this->id = convertTo<unsigned int>(token.substr(3));
-					}
-					catch (const ConvertException &) { }
-
-					continue;
-				}
-				else if (token.find("DATA ") != 0)
-					break;
-
-				size_t sp = token.find(' ', 5); // Skip DATA
-				if (sp != Anope::string::npos)
-					data[token.substr(5, sp - 5)] = token.substr(sp + 1);
+				Log(this) << "Skipping corrupt " << stype->GetName() << " object #" << i;
+				continue;
 			}
 
-			read = true;
+			Serializable *obj = stype->Unserialize(NULL, ld);
+			if (obj != NULL)
+				obj->id = ld.id;
 		}
 
-		ss.clear();
-		this->ss << this->data[key];
-		return this->ss;
+		return t->count;
 	}
 
-	std::set<Anope::string> KeySet() const anope_override
+	/** Loads the objects in a text database. The database is split into parts that are
+	 * parsed at the same time, then the objects are unserialized in the order of their types.
+	 * @param db_name The database
+	 * @param only If set, only objects of this type are loaded, otherwise objects of every type without an owner are
+	 * @return false if the database can not be opened
+	 */
+	bool LoadText(const Anope::string &db_name, Serialize::Type *only)
 	{
-		std::set<Anope::string> keys;
-		for (std::map<Anope::string, Anope::string>::const_iterator it = this->data.begin(), it_end = this->data.end(); it != it_end; ++it)
-			keys.insert(it->first);
-		return keys;
+		ElapsedTimer timer;
+
+		MappedFile file;
+		if (!file.Open(db_name))
+		{
+			if (Anope::IsFile(db_name))
+			{
+				/* Don't continue without the database, it would be overwritten with an empty one on the next save */
+				Anope::Quitting = true;
+				Anope::QuitReason = "Unable to read database " + db_name;
+			}
+			return false;
+		}
+
+		const char *data = file.GetData(), *end = data + file.GetSize();
+		long read_time = timer.Elapsed();
+		timer.Reset();
+
+		/* Small databases are not worth starting threads for */
+		unsigned threads = Config->GetModule(this)->Get<unsigned>("loadthreads");
+		if (!threads)
+			threads = GetProcessorCount();
+		threads = std::max<size_t>(std::min<size_t>(threads, file.GetSize() >> 20), 1);
+
+		/* Each part starts on an OBJECT line */
+		std::vector<TextParseThread *> parsers;
+		const char *begin = data;
+		for (unsigned i = 1; i <= threads && begin < end; ++i)
+		{
+			const char *split = i < threads ? data + file.GetSize() / threads * i : end;
+			if (split <= begin)
+				continue;
+
+			static const char object[] = "\nOBJECT ";
+			split = std::search(split - 1, end, object, object + sizeof(object) - 1);
+			if (split != end)
+				++split;
+
+			parsers.push_back(new TextParseThread(begin, split));
+			begin = split;
+		}
+
+		/* This thread parses the first part, and any part a thread can not be started for */
+		std::vector<TextParseThread *> started;
+		for (unsigned i = 1; i < parsers.size(); ++i)
+		{
+			try
+			{
+				parsers[i]->Start();
+				started.push_back(parsers[i]);
+			}
+			catch (const CoreException &ex)
+			{
+				Log(this) << ex.GetReason();
+			}
+		}
+
+		for (unsigned i = 0; i < parsers.size(); ++i)
+			if (std::find(started.begin(), started.end(), parsers[i]) == started.end())
+				parsers[i]->Run();
+
+		for (unsigned i = 0; i < started.size(); ++i)
+			started[i]->Join();
+
+		/* Group the records by type, keeping them in the order they are in the database */
+		std::map<Anope::string, std::vector<const TextRecord *> > records;
+		std::vector<const TextRecord *> *type_records = NULL;
+		const TextRecord *last = NULL;
+		for (unsigned i = 0; i < parsers.size(); ++i)
+			for (unsigned j = 0; j < parsers[i]->records.size(); ++j)
+			{
+				const TextRecord *r = &parsers[i]->records[j];
+				if (!last || r->type_len != last->type_len || memcmp(r->type, last->type, r->type_len))
+					type_records = &records[Anope::string(r->type, r->type + r->type_len)];
+				type_records->push_back(r);
+				last = r;
+			}
+
+		long parse_time = timer.Elapsed();
+		timer.Reset();
+
+		const std::vector<Anope::string> &type_order = Serialize::Type::GetTypeOrder();
+		TextLoadData ld;
+		size_t objects = 0;
+		for (unsigned i = 0; i < type_order.size(); ++i)
+		{
+			Serialize::Type *stype = Serialize::Type::Find(type_order[i]);
+			if (!stype || (only ? stype != only : stype->GetOwner() != NULL))
+				continue;
+
+			const std::vector<const TextRecord *> &type_objects = records[stype->GetName()];
+			for (unsigned j = 0; j < type_objects.size(); ++j)
+			{
+				ld.SetRecord(type_objects[j]);
+
+				Serializable *obj = stype->Unserialize(NULL, ld);
+				if (obj != NULL)
+					obj->id = type_objects[j]->id;
+			}
+			objects += type_objects.size();
+		}
+
+		long unserialize_time = timer.Elapsed();
+
+		for (unsigned i = 0; i < parsers.size(); ++i)
+			delete parsers[i];
+
+		if (!only)
+			Log(this) << "Loaded " << objects << " objects from " << db_name << " in " << (read_time + parse_time + unserialize_time) << "ms (read " << read_time << "ms, parsed by " << parsers.size() << " threads in " << parse_time << "ms, unserialized in " << unserialize_time << "ms)";
+
+		return true;
 	}
 
-	size_t Hash() const anope_override
+	/** Opens a binary database
+	 * @return true if the database is binary, even if it can not be read
+	 */
+	bool OpenBinary(BinaryDatabase &db, const Anope::string &db_name)
 	{
-		size_t hash = 0;
-		for (std::map<Anope::string, Anope::string>::const_iterator it = this->data.begin(), it_end = this->data.end(); it != it_end; ++it)
-			if (!it->second.empty())
-				hash ^= Anope::hash_cs()(it->second);
-		return hash;
+		Anope::string error;
+		if (!db.Open(db_name, error))
+			return false;
+
+		if (!error.empty())
+		{
+			Log(this) << "Unable to load database " << db_name << ": " << error;
+
+			/* Don't continue without the database, it would be overwritten with an empty one on the next save */
+			Anope::Quitting = true;
+			Anope::QuitReason = "Unable to load database " + db_name + " (" + error + ")";
+			db.types.clear();
+		}
+
+		return true;
 	}
 
-	void Reset()
+	Anope::string GetDatabaseName(Module *owner)
 	{
-		id = 0;
-		read = false;
-		data.clear();
+		if (owner)
+			return Anope::DataDir + "/module_" + owner->name + ".db";
+		return Anope::DataDir + "/" + Config->GetModule(this)->Get<const Anope::string>("database", "anope.db");
 	}
-};
-
-class DBFlatFile : public Module, public Pipe
-{
-	/* Day the last backup was on */
-	int last_day;
-	/* Backup file names */
-	std::map<Anope::string, std::list<Anope::string> > backups;
-	bool loaded;
-
-	int child_pid;
 
 	void BackupDatabase()
 	{
@@ -172,12 +1794,109 @@ class DBFlatFile : public Module, public Pipe
 	}
 
  public:
-	DBFlatFile(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, DATABASE | VENDOR), last_day(0), loaded(false), child_pid(-1)
+	DBFlatFile(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, DATABASE | VENDOR), last_day(0), loaded(false), child_pid(-1),
+		journal_enabled(false), notifier(this), replaying(false), flushing(false), shutting_down(false), last_compaction(0),
+		snapshot_tracking(false), last_refresh(0), writer(NULL), snapshot_pause(0), snapshot_serialized(0)
 	{
 
 	}
 
-#ifndef _WIN32
+	~DBFlatFile()
+	{
+		this->WaitForSnapshot();
+		this->ClearSnapshot();
+	}
+
+	void WaitForSnapshot()
+	{
+		if (!writer)
+			return;
+
+		SnapshotWriter *w = writer;
+		w->Join();
+		this->FinishSnapshot();
+		delete w;
+	}
+
+	/** Called once the writer has written out the last snapshot. The writer is deleted by the caller */
+	void FinishSnapshot()
+	{
+		for (unsigned i = 0; i < writer->failed.size(); ++i)
+			Log(this) << "Unable to write database " << writer->failed[i];
+
+		Log(this) << "Finished saving databases in " << save_timer.Elapsed() << "ms (main thread paused for " << snapshot_pause << "ms to serialize "
+			<< snapshot_serialized << " of " << snapshot_records.size() << " objects, written in " << writer->write_time << "ms)";
+
+		if (writer->failed.empty())
+			/* The journal from before this save is no longer needed */
+			unlink((this->GetJournalName() + ".old").c_str());
+		else if (!Config->GetModule(this)->Get<bool>("nobackupokay"))
+			Anope::Quitting = true;
+
+		writer = NULL;
+
+		for (unsigned i = 0; i < released.size(); ++i)
+			delete released[i];
+		released.clear();
+	}
+
+	/** Writes the changes made since the journal was last written */
+	void FlushJournal()
+	{
+		if (!journal.is_open() || (pending.empty() && deletes.empty()))
+			return;
+
+		for (unsigned i = 0; i < deletes.size(); ++i)
+			/* Objects destroyed by unloading the module of their type are still in the database for when it is loaded again */
+			if (Serialize::Type::Find(deletes[i].first))
+				journal << "DELETE " << deletes[i].first << " " << deletes[i].second << "\n";
+		deletes.clear();
+
+		/* Objects are written in the order their types are loaded in, so they are written after the objects they depend on */
+		std::map<Serialize::Type *, std::vector<Serializable *> > objects;
+		for (unsigned i = 0; i < pending.size(); ++i)
+			if (pending[i]->GetSerializableType())
+				objects[pending[i]->GetSerializableType()].push_back(pending[i]);
+		pending.clear();
+		pending_set.clear();
+
+		const std::vector<Anope::string> &type_order = Serialize::Type::GetTypeOrder();
+		SaveData data;
+		data.fs = &journal;
+
+		flushing = true;
+		for (unsigned i = 0; i < type_order.size(); ++i)
+		{
+			Serialize::Type *stype = Serialize::Type::Find(type_order[i]);
+			std::map<Serialize::Type *, std::vector<Serializable *> >::iterator it = objects.find(stype);
+			if (it == objects.end())
+				continue;
+
+			for (unsigned j = 0; j < it->second.size(); ++j)
+			{
+				Serializable *obj = it->second[j];
+
+				if (!obj->id)
+					this->AssignId(obj);
+
+				journal << "OBJECT " << stype->GetName() << "\nID " << obj->id;
+				data.last.clear();
+				obj->Serialize(data);
+				journal << "\nEND\n";
+
+				obj->Commit();
+			}
+		}
+		flushing = false;
+
+		journal.flush();
+		if (!journal.good())
+		{
+			Log(this) << "Unable to write to " << this->GetJournalName() << "!";
+			journal.clear();
+		}
+	}
+
 	void OnRestart() anope_override
 	{
 		OnShutdown();
@@ -185,6 +1904,13 @@ class DBFlatFile : public Module, public Pipe
 
 	void OnShutdown() anope_override
 	{
+		/* Objects destroyed while shutting down are still in the database */
+		this->FlushJournal();
+		shutting_down = true;
+
+		this->WaitForSnapshot();
+
+#ifndef _WIN32
 		if (child_pid > -1)
 		{
 			Log(this) << "Waiting for child to exit...";
@@ -194,8 +1920,75 @@ class DBFlatFile : public Module, public Pipe
 
 			Log(this) << "Done";
 		}
-	}
 #endif
+	}
+
+	void OnModuleUnload(User *, Module *) anope_override
+	{
+		/* Changes to the objects the module destroys are lost otherwise */
+		this->FlushJournal();
+	}
+
+	void OnSerializableConstruct(Serializable *obj) anope_override
+	{
+		this->QueueJournal(obj);
+
+		if (snapshot_tracking)
+			this->TrackSnapshot(obj);
+	}
+
+	void OnSerializableUpdate(Serializable *obj) anope_override
+	{
+		/* Only looked at while writing another object out, so it has not changed since it was last written */
+		if (flushing)
+		{
+			obj->Commit();
+			return;
+		}
+
+		this->QueueJournal(obj);
+
+		if (snapshot_tracking)
+		{
+			std::map<Serializable *, std::list<SnapshotRecord *>::iterator>::iterator it = snapshot_records.find(obj);
+			if (it != snapshot_records.end())
+				(*it->second)->changed = true;
+		}
+	}
+
+	void OnSerializableDestruct(Serializable *obj) anope_override
+	{
+		if (pending_set.erase(obj))
+			pending.erase(std::find(pending.begin(), pending.end(), obj));
+
+		std::map<Serializable *, std::list<SnapshotRecord *>::iterator>::iterator sit = snapshot_records.find(obj);
+		if (sit != snapshot_records.end())
+		{
+			/* The writer may still be writing it out */
+			if (writer)
+				released.push_back(*sit->second);
+			else
+				delete *sit->second;
+			snapshot.erase(sit->second);
+			snapshot_records.erase(sit);
+		}
+
+		Serialize::Type *stype = obj->GetSerializableType();
+		if (!stype || !obj->id)
+			return;
+
+		std::map<uint64_t, Serializable *>::iterator it = stype->objects.find(obj->id);
+		if (it == stype->objects.end() || it->second != obj)
+			return;
+		stype->objects.erase(it);
+
+		if (!journal.is_open() || replaying || shutting_down)
+			return;
+
+		if (pending.empty() && deletes.empty())
+			notifier.Notify();
+		deletes.push_back(std::make_pair(stype->GetName(), obj->id));
+	}
 
 	void OnNotify() anope_override
 	{
@@ -226,58 +2019,76 @@ class DBFlatFile : public Module, public Pipe
 
 		const Anope::string &db_name = Anope::DataDir + "/" + Config->GetModule(this)->Get<const Anope::string>("database", "anope.db");
 
-		std::fstream fd(db_name.c_str(), std::ios_base::in | std::ios_base::binary);
-		if (!fd.is_open())
-		{
-			Log(this) << "Unable to open " << db_name << " for reading!";
-			return EVENT_STOP;
-		}
-
-		std::map<Anope::string, std::vector<std::streampos> > positions;
-
-		for (Anope::string buf; std::getline(fd, buf.str());)
-			if (buf.find("OBJECT ") == 0)
-				positions[buf.substr(7)].push_back(fd.tellg());
-
-		LoadData ld;
-		ld.fs = &fd;
-
-		for (unsigned i = 0; i < type_order.size(); ++i)
+		/* Either format is loaded regardless of which one is configured, so changing the format converts the databases when they are next saved */
+		ElapsedTimer timer;
+		BinaryDatabase db;
+		if (this->OpenBinary(db, db_name))
 		{
-			Serialize::Type *stype = Serialize::Type::Find(type_order[i]);
-			if (!stype || stype->GetOwner())
-				continue;
+			long index_time = timer.Elapsed();
+			timer.Reset();
 
-			std::vector<std::streampos> &pos = positions[stype->GetName()];
-
-			for (unsigned j = 0; j < pos.size(); ++j)
+			size_t objects = 0;
+			for (unsigned i = 0; i < type_order.size(); ++i)
 			{
-				fd.clear();
-				fd.seekg(pos[j]);
-
-				Serializable *obj = stype->Unserialize(NULL, ld);
-				if (obj != NULL)
-					obj->id = ld.id;
-				ld.Reset();
+				Serialize::Type *stype = Serialize::Type::Find(type_order[i]);
+				if (stype && !stype->GetOwner())
+					objects += this->LoadBinary(db, stype);
 			}
-		}
 
-		fd.close();
+			long unserialize_time = timer.Elapsed();
+			Log(this) << "Loaded " << objects << " objects from " << db_name << " in " << (index_time + unserialize_time) << "ms (indexed in " << index_time << "ms, unserialized in " << unserialize_time << "ms)";
 
-		loaded = true;
+			loaded = true;
+		}
+		else if (this->LoadText(db_name, NULL))
+			loaded = true;
+		else
+			Log(this) << "Unable to open " << db_name << " for reading!";
+
+		this->LoadJournal(NULL);
 		return EVENT_STOP;
 	}
 
 
 	void OnSaveDatabase() anope_override
 	{
-		if (child_pid > -1)
+		if (journal_enabled)
+		{
+			this->FlushJournal();
+
+			/* Everything since the last full save is in the journal, so only save fully every so often to keep it short.
+			 * Always save fully when shutting down, as changes to objects which were not marked as changed are only in a full save.
+			 */
+			if (!Anope::Quitting && Anope::CurTime - last_compaction < Config->GetModule(this)->Get<time_t>("compactinterval", "1h"))
+				return;
+		}
+
+		/* Changes made since the snapshot being written was taken would be lost otherwise */
+		if (Anope::Quitting)
+			this->WaitForSnapshot();
+
+		if (child_pid > -1 || writer)
 		{
 			Log(this) << "Database save is already in progress!";
 			return;
 		}
 
+		last_compaction = Anope::CurTime;
+
 		BackupDatabase();
+		this->RotateJournal();
+
+		/* Every object is written out below, so nothing is left to commit */
+		const std::set<Serializable *> &dirty = Serializable::GetDirtyItems();
+		while (!dirty.empty())
+			(*dirty.begin())->Commit();
+
+		if (Config->GetModule(this)->Get<bool>("snapshot"))
+		{
+			this->SaveSnapshot(Config->GetModule(this)->Get<const Anope::string>("format", "text") == "binary");
+			return;
+		}
+		this->ClearSnapshot();
 
 		int i = -1;
 #ifndef _WIN32
@@ -297,6 +2108,8 @@ class DBFlatFile : public Module, public Pipe
 		try
 		{
 			std::map<Module *, std::fstream *> databases;
+			std::map<Module *, BinaryWriter *> writers;
+			bool binary = Config->GetModule(this)->Get<const Anope::string>("format", "text") == "binary";
 
 			/* First open the databases of all of the registered types. This way, if we have a type with 0 objects, that database will be properly cleared */
 			for (std::map<Anope::string, Serialize::Type *>::const_iterator it = Serialize::Type::GetTypes().begin(), it_end = Serialize::Type::GetTypes().end(); it != it_end; ++it)
@@ -319,9 +2132,14 @@ class DBFlatFile : public Module, public Pipe
 
 				if (!fs->is_open())
 					Log(this) << "Unable to open " << db_name << " for writing";
+				else if (binary)
+					writers[s_type->GetOwner()] = new BinaryWriter(fs);
 			}
 
 			SaveData data;
+			BinarySaveData binary_data;
+			bool failed = false;
+			flushing = true;
 			const std::list<Serializable *> &items = Serializable::GetItems();
 			for (std::list<Serializable *>::const_iterator it = items.begin(), it_end = items.end(); it != it_end; ++it)
 			{
@@ -332,12 +2150,25 @@ class DBFlatFile : public Module, public Pipe
 				if (!data.fs || !data.fs->is_open())
 					continue;
 
+				if (binary)
+				{
+					binary_data.Save(writers[s_type->GetOwner()], base);
+					continue;
+				}
+
 				*data.fs << "OBJECT " << s_type->GetName();
 				if (base->id)
 					*data.fs << "\nID " << base->id;
 				base->Serialize(data);
 				*data.fs << "\nEND\n";
 			}
+			flushing = false;
+
+			for (std::map<Module *, BinaryWriter *>::iterator it = writers.begin(), it_end = writers.end(); it != it_end; ++it)
+			{
+				it->second->Finish();
+				delete it->second;
+			}
 
 			for (std::map<Module *, std::fstream *>::iterator it = databases.begin(), it_end = databases.end(); it != it_end; ++it)
 			{
@@ -347,6 +2178,7 @@ class DBFlatFile : public Module, public Pipe
 				if (!f->is_open() || !f->good())
 				{
 					this->Write("Unable to write database " + db_name);
+					failed = true;
 
 					f->close();
 
@@ -361,9 +2193,14 @@ class DBFlatFile : public Module, public Pipe
 
 				delete f;
 			}
+
+			/* The journal from before this save is no longer needed */
+			if (!failed)
+				unlink((this->GetJournalName() + ".old").c_str());
 		}
 		catch (...)
 		{
+			flushing = false;
 			if (i)
 				throw;
 		}
@@ -376,38 +2213,51 @@ class DBFlatFile : public Module, public Pipe
 	}
 
 	/* Load just one type. Done if a module is reloaded during runtime */
-	void OnSerializeTypeCreate(Serialize::Type *stype) anope_override
+	void LoadType(Serialize::Type *stype)
 	{
-		if (!loaded)
-			return;
-
 		Anope::string db_name;
 		if (stype->GetOwner())
 			db_name = Anope::DataDir + "/module_" + stype->GetOwner()->name + ".db";
 		else
 			db_name = Anope::DataDir + "/" + Config->GetModule(this)->Get<const Anope::string>("database", "anope.db");
 
-		std::fstream fd(db_name.c_str(), std::ios_base::in | std::ios_base::binary);
-		if (!fd.is_open())
-		{
+		BinaryDatabase db;
+		if (this->OpenBinary(db, db_name))
+			this->LoadBinary(db, stype);
+		else if (!this->LoadText(db_name, stype))
 			Log(this) << "Unable to open " << db_name << " for reading!";
+	}
+
+	void OnSerializeTypeCreate(Serialize::Type *stype) anope_override
+	{
+		if (!loaded)
 			return;
-		}
 
-		LoadData ld;
-		ld.fs = &fd;
+		/* The objects destroyed when the type's module was unloaded are loaded again from the database and journal */
+		std::vector<std::pair<Anope::string, uint64_t> > other_deletes;
+		for (unsigned i = 0; i < deletes.size(); ++i)
+			if (deletes[i].first != stype->GetName())
+				other_deletes.push_back(deletes[i]);
+		deletes.swap(other_deletes);
+		this->FlushJournal();
 
-		for (Anope::string buf; std::getline(fd, buf.str());)
-		{
-			if (buf == "OBJECT " + stype->GetName())
-			{
-				stype->Unserialize(NULL, ld);
-				ld.Reset();
-			}
-		}
+		replaying = true;
+		this->LoadType(stype);
+		replaying = false;
 
-		fd.close();
+		this->LoadJournal(stype);
 	}
 };
 
+void JournalNotifier::OnNotify()
+{
+	db->FlushJournal();
+}
+
+void SnapshotWriter::OnNotify()
+{
+	Thread::OnNotify();
+	db->FinishSnapshot();
+}
+
 MODULE_INIT(DBFlatFile)
@@ -16,37 +16,116 @@ static DatabaseRedis *me;
 
 class Data : public Serialize::Data
 {
+	/* Fields which have been used through streams. A stream is only made for a field when one is asked for */
+	std::map<Anope::string, std::stringstream *> streams;
+
  public:
-	std::map<Anope::string, std::stringstream *> data;
+	/* The values of fields which have not been used through streams */
+	std::map<Anope::string, Anope::string> values;
 
 	~Data()
 	{
-		for (std::map<Anope::string, std::stringstream *>::iterator it = data.begin(), it_end = data.end(); it != it_end; ++it)
+		for (std::map<Anope::string, std::stringstream *>::iterator it = streams.begin(), it_end = streams.end(); it != it_end; ++it)
 			delete it->second;
 	}
 
 	std::iostream& operator[](const Anope::string &key) anope_override
 	{
-		std::stringstream* &stream = data[key];
+		std::stringstream* &stream = streams[key];
 		if (!stream)
+		{
 			stream = new std::stringstream();
+
+			std::map<Anope::string, Anope::string>::iterator it = values.find(key);
+			if (it != values.end())
+			{
+				*stream << it->second;
+				values.erase(it);
+			}
+		}
 		return *stream;
 	}
 
+	void Set(const Serialize::Key &key, int64_t value) anope_override
+	{
+		this->Set(key, stringify(value));
+	}
+
+	void Set(const Serialize::Key &key, const Anope::string &value) anope_override
+	{
+		std::map<Anope::string, std::stringstream *>::iterator it = streams.find(key.GetName());
+		if (it != streams.end())
+		{
+			delete it->second;
+			streams.erase(it);
+		}
+
+		values[key.GetName()] = value;
+	}
+
+	bool Get(const Serialize::Key &key, int64_t &value) anope_override
+	{
+		if (streams.count(key.GetName()))
+			return Serialize::Data::Get(key, value);
+
+		value = 0;
+		std::map<Anope::string, Anope::string>::const_iterator it = values.find(key.GetName());
+		if (it == values.end())
+			return false;
+
+		try
+		{
+			value = convertTo<int64_t>(it->second, false);
+			return true;
+		}
+		catch (const ConvertException &)
+		{
+			return false;
+		}
+	}
+
+	bool Get(const Serialize::Key &key, Anope::string &value) anope_override
+	{
+		if (streams.count(key.GetName()))
+			return Serialize::Data::Get(key, value);
+
+		std::map<Anope::string, Anope::string>::const_iterator it = values.find(key.GetName());
+		if (it == values.end())
+		{
+			value.clear();
+			return false;
+		}
+
+		value = it->second;
+		return !value.empty();
+	}
+
+	/** Gets the value of every field, whether it was set through a stream or not */
+	std::map<Anope::string, Anope::string> GetValues() const
+	{
+		std::map<Anope::string, Anope::string> v = values;
+		for (std::map<Anope::string, std::stringstream *>::const_iterator it = this->streams.begin(), it_end = this->streams.end(); it != it_end; ++it)
+			v[it->first] = it->second->str();
+		return v;
+	}
+
 	std::set<Anope::string> KeySet() const anope_override
 	{
 		std::set<Anope::string> keys;
-		for (std::map<Anope::string, std::stringstream *>::const_iterator it = this->data.begin(), it_end = this->data.end(); it != it_end; ++it)
+		for (std::map<Anope::string, Anope::string>::const_iterator it = this->values.begin(), it_end = this->values.end(); it != it_end; ++it)
+			keys.insert(it->first);
+		for (std::map<Anope::string, std::stringstream *>::const_iterator it = this->streams.begin(), it_end = this->streams.end(); it != it_end; ++it)
 			keys.insert(it->first);
 		return keys;
 	}
 
 	size_t Hash() const anope_override
 	{
+		const std::map<Anope::string, Anope::string> &v = this->GetValues();
 		size_t hash = 0;
-		for (std::map<Anope::string, std::stringstream *>::const_iterator it = this->data.begin(), it_end = this->data.end(); it != it_end; ++it)
-			if (!it->second->str().empty())
-				hash ^= Anope::hash_cs()(it->second->str());
+		for (std::map<Anope::string, Anope::string>::const_iterator it = v.begin(), it_end = v.end(); it != it_end; ++it)
+			if (!it->second.empty())
+				hash ^= Anope::hash_cs()(it->second);
 		return hash;
 	}
 };
@@ -122,6 +201,8 @@ class DatabaseRedis : public Module, public Pipe
 {
 	SubscriptionListener sl;
 	std::set<Serializable *> updated_items;
+	/* Objects being written by OnNotify, objects updated meanwhile are written on the next notify */
+	std::set<Serializable *> processing;
 
  public:
 	ServiceReference<Provider> redis;
@@ -146,7 +227,11 @@ class DatabaseRedis : public Module, public Pipe
 			obj->Serialize(data);
 
 			if (obj->IsCached(data))
+			{
+				/* Nothing has actually changed */
+				obj->Commit();
 				return;
+			}
 
 			obj->UpdateCache(data);
 
@@ -161,14 +246,14 @@ class DatabaseRedis : public Module, public Pipe
 
 	void OnNotify() anope_override
 	{
-		for (std::set<Serializable *>::iterator it = this->updated_items.begin(), it_end = this->updated_items.end(); it != it_end; ++it)
+		this->processing.swap(this->updated_items);
+		while (!this->processing.empty())
 		{
-			Serializable *s = *it;
+			Serializable *s = *this->processing.begin();
+			this->processing.erase(this->processing.begin());
 
 			this->InsertObject(s);
 		}
-
-		this->updated_items.clear();
 	}
 
 	void OnReload(Configuration::Conf *conf) anope_override
@@ -247,6 +332,7 @@ class DatabaseRedis : public Module, public Pipe
 		redis->SendCommand(new Deleter(this, t->GetName(), obj->id), args);
 
 		this->updated_items.erase(obj);
+		this->processing.erase(obj);
 		t->objects.erase(obj->id);
 		this->Notify();
 	}
@@ -310,7 +396,7 @@ void ObjectLoader::OnResult(const Reply &r)
 		const Reply *key = r.multi_bulk[i],
 			*value = r.multi_bulk[i + 1];
 
-		data[key->bulk] << value->bulk;
+		data.values[key->bulk] = value->bulk;
 	}
 
 	Serializable* &obj = st->objects[this->id];
@@ -440,19 +526,20 @@ void Updater::OnResult(const Reply &r)
 	args.push_back("HMSET");
 	args.push_back("hash:" + this->type + ":" + stringify(obj->id));
 
-	typedef std::map<Anope::string, std::stringstream *> items;
-	for (items::iterator it = data.data.begin(), it_end = data.data.end(); it != it_end; ++it)
+	typedef std::map<Anope::string, Anope::string> items;
+	const items &values = data.GetValues();
+	for (items::const_iterator it = values.begin(), it_end = values.end(); it != it_end; ++it)
 	{
 		const Anope::string &key = it->first;
-		std::stringstream *value = it->second;
+		const Anope::string &value = it->second;
 
 		args.push_back(key);
-		args.push_back(value->str());
+		args.push_back(value);
 
 		std::vector<Anope::string> args2;
 
 		args2.push_back("SADD");
-		args2.push_back("value:" + this->type + ":" + key + ":" + value->str());
+		args2.push_back("value:" + this->type + ":" + key + ":" + value);
 		args2.push_back(stringify(obj->id));
 
 		/* Add to value -> object id set */
@@ -549,15 +636,16 @@ void SubscriptionListener::OnResult(const Reply &r)
 		/* Transaction start */
 		me->redis->StartTransaction();
 
-		typedef std::map<Anope::string, std::stringstream *> items;
-		for (items::iterator it = data.data.begin(), it_end = data.data.end(); it != it_end; ++it)
+		typedef std::map<Anope::string, Anope::string> items;
+		const items &values = data.GetValues();
+		for (items::const_iterator it = values.begin(), it_end = values.end(); it != it_end; ++it)
 		{
 			const Anope::string &k = it->first;
-			std::stringstream *value = it->second;
+			const Anope::string &value = it->second;
 
 			std::vector<Anope::string> args;
 			args.push_back("SREM");
-			args.push_back("value:" + type + ":" + k + ":" + value->str());
+			args.push_back("value:" + type + ":" + k + ":" + value);
 			args.push_back(id);
 
 			/* Delete value -> object id */
@@ -602,15 +690,16 @@ void ModifiedObject::OnResult(const Reply &r)
 
 		obj->Serialize(data);
 
-		typedef std::map<Anope::string, std::stringstream *> items;
-		for (items::iterator it = data.data.begin(), it_end = data.data.end(); it != it_end; ++it)
+		typedef std::map<Anope::string, Anope::string> items;
+		const items &values = data.GetValues();
+		for (items::const_iterator it = values.begin(), it_end = values.end(); it != it_end; ++it)
 		{
 			const Anope::string &key = it->first;
-			std::stringstream *value = it->second;
+			const Anope::string &value = it->second;
 
 			std::vector<Anope::string> args;
 			args.push_back("SREM");
-			args.push_back("value:" + st->GetName() + ":" + key + ":" + value->str());
+			args.push_back("value:" + st->GetName() + ":" + key + ":" + value);
 			args.push_back(stringify(this->id));
 
 			/* Delete value -> object id */
@@ -625,7 +714,7 @@ void ModifiedObject::OnResult(const Reply &r)
 		const Reply *key = r.multi_bulk[i],
 			*value = r.multi_bulk[i + 1];
 
-		data[key->bulk] << value->bulk;
+		data.values[key->bulk] = value->bulk;
 	}
 
 	obj = st->Unserialize(obj, data);
@@ -635,15 +724,16 @@ void ModifiedObject::OnResult(const Reply &r)
 		obj->UpdateCache(data);
 
 		/* Insert new object values */
-		typedef std::map<Anope::string, std::stringstream *> items;
-		for (items::iterator it = data.data.begin(), it_end = data.data.end(); it != it_end; ++it)
+		typedef std::map<Anope::string, Anope::string> items;
+		const items &values = data.GetValues();
+		for (items::const_iterator it = values.begin(), it_end = values.end(); it != it_end; ++it)
 		{
 			const Anope::string &key = it->first;
-			std::stringstream *value = it->second;
+			const Anope::string &value = it->second;
 
 			std::vector<Anope::string> args;
 			args.push_back("SADD");
-			args.push_back("value:" + st->GetName() + ":" + key + ":" + value->str());
+			args.push_back("value:" + st->GetName() + ":" + key + ":" + value);
 			args.push_back(stringify(obj->id));
 
 			/* Add to value -> object id set */
@@ -36,17 +36,13 @@ class SQLSQLInterface : public Interface
 class ResultSQLSQLInterface : public SQLSQLInterface
 {
 	Reference<Serializable> obj;
+	/* The generation of obj which was inserted */
+	unsigned int generation;
 
 public:
-	ResultSQLSQLInterface(Module *o, Serializable *ob) : SQLSQLInterface(o), obj(ob) { }
+	ResultSQLSQLInterface(Module *o, Serializable *ob) : SQLSQLInterface(o), obj(ob), generation(ob->GetGeneration()) { }
 
-	void OnResult(const Result &r) anope_override
-	{
-		SQLSQLInterface::OnResult(r);
-		if (r.GetID() > 0 && this->obj)
-			this->obj->id = r.GetID();
-		delete this;
-	}
+	void OnResult(const Result &r) anope_override;
 
 	void OnError(const Result &r) anope_override
 	{
@@ -63,10 +59,15 @@ class DBSQL : public Module, public Pipe
 	bool import;
 
 	std::set<Serializable *> updated_items;
+	/* Objects being written by OnNotify, objects updated meanwhile are written on the next notify */
+	std::set<Serializable *> processing;
 	bool shutting_down;
 	bool loading_databases;
 	bool loaded;
 	bool imported;
+	/* How long loading the databases took, and how many objects were loaded */
+	long query_time, unserialize_time;
+	size_t loaded_objects;
 
 	void RunBackground(const Query &q, Interface *iface = NULL)
 	{
@@ -90,7 +91,8 @@ class DBSQL : public Module, public Pipe
 	}
 
  public:
-	DBSQL(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, DATABASE | VENDOR), sql("", ""), sqlinterface(this), shutting_down(false), loading_databases(false), loaded(false), imported(false)
+	DBSQL(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, DATABASE | VENDOR), sql("", ""), sqlinterface(this), shutting_down(false), loading_databases(false), loaded(false), imported(false),
+		query_time(0), unserialize_time(0), loaded_objects(0)
 	{
 
 
@@ -100,54 +102,60 @@ class DBSQL : public Module, public Pipe
 
 	void OnNotify() anope_override
 	{
-		for (std::set<Serializable *>::iterator it = this->updated_items.begin(), it_end = this->updated_items.end(); it != it_end; ++it)
+		/* Keep the updates until the SQL provider is back, as they won't be sent again */
+		if (!this->sql)
+			return;
+
+		this->processing.swap(this->updated_items);
+		while (!this->processing.empty())
 		{
-			Serializable *obj = *it;
+			Serializable *obj = *this->processing.begin();
+			this->processing.erase(this->processing.begin());
+
+			Data data;
+			obj->Serialize(data);
+
+			if (obj->IsCached(data))
+			{
+				/* Nothing has actually changed */
+				obj->Commit();
+				continue;
+			}
+
+			obj->UpdateCache(data);
+
+			/* If we didn't load these objects and we don't want to import just update the cache and continue */
+			if (!this->loaded && !this->imported && !this->import)
+				continue;
+
+			Serialize::Type *s_type = obj->GetSerializableType();
+			if (!s_type)
+				continue;
+
+			std::vector<Query> create = this->sql->CreateTable(this->prefix + s_type->GetName(), data);
+			Query insert = this->sql->BuildInsert(this->prefix + s_type->GetName(), obj->id, data);
 
-			if (this->sql)
+			if (this->imported)
 			{
-				Data data;
-				obj->Serialize(data);
-
-				if (obj->IsCached(data))
-					continue;
-
-				obj->UpdateCache(data);
-
-				/* If we didn't load these objects and we don't want to import just update the cache and continue */
-				if (!this->loaded && !this->imported && !this->import)
-					continue;
-
-				Serialize::Type *s_type = obj->GetSerializableType();
-				if (!s_type)
-					continue;
-
-				std::vector<Query> create = this->sql->CreateTable(this->prefix + s_type->GetName(), data);
-				Query insert = this->sql->BuildInsert(this->prefix + s_type->GetName(), obj->id, data);
-
-				if (this->imported)
-				{
-					for (unsigned i = 0; i < create.size(); ++i)
-						this->RunBackground(create[i]);
-
-					this->RunBackground(insert, new ResultSQLSQLInterface(this, obj));
-				}
-				else
-				{
-					for (unsigned i = 0; i < create.size(); ++i)
-						this->sql->RunQuery(create[i]);
-
-					/* We are importing objects from another database module, so don't do asynchronous
-					 * queries in case the core has to shut down, it will cut short the import
-					 */
-					Result r = this->sql->RunQuery(insert);
-					if (r.GetID() > 0)
-						obj->id = r.GetID();
-				}
+				for (unsigned i = 0; i < create.size(); ++i)
+					this->RunBackground(create[i]);
+
+				this->RunBackground(insert, new ResultSQLSQLInterface(this, obj));
+			}
+			else
+			{
+				for (unsigned i = 0; i < create.size(); ++i)
+					this->sql->RunQuery(create[i]);
+
+				/* We are importing objects from another database module, so don't do asynchronous
+				 * queries in case the core has to shut down, it will cut short the import
+				 */
+				Result r = this->sql->RunQuery(insert);
+				if (r.GetID() > 0)
+					obj->id = r.GetID();
 			}
 		}
 
-		this->updated_items.clear();
 		this->imported = true;
 	}
 
@@ -190,6 +198,8 @@ class DBSQL : public Module, public Pipe
 		this->loading_databases = false;
 		this->loaded = true;
 
+		Log(this) << "Loaded " << this->loaded_objects << " objects in " << (this->query_time + this->unserialize_time) << "ms (queried in " << this->query_time << "ms, unserialized in " << this->unserialize_time << "ms)";
+
 		return EVENT_STOP;
 	}
 
@@ -210,15 +220,15 @@ class DBSQL : public Module, public Pipe
 		if (s_type && obj->id > 0)
 			this->RunBackground("DELETE FROM `" + this->prefix + s_type->GetName() + "` WHERE `id` = " + stringify(obj->id));
 		this->updated_items.erase(obj);
+		this->processing.erase(obj);
 	}
 
 	void OnSerializableUpdate(Serializable *obj) anope_override
 	{
-		if (this->shutting_down || obj->IsTSCached())
+		if (this->shutting_down)
 			return;
 		if (obj->id == 0)
-			return; /* object is pending creation */
-		obj->UpdateTS();
+			return; /* object is pending creation, it is queued again once it has an id if it changes */
 		this->updated_items.insert(obj);
 		this->Notify();
 	}
@@ -228,9 +238,14 @@ class DBSQL : public Module, public Pipe
 		if (!this->loading_databases && !this->loaded)
 			return;
 
+		ElapsedTimer timer;
+
 		Query query("SELECT * FROM `" + this->prefix + sb->GetName() + "`");
 		Result res = this->sql->RunQuery(query);
 
+		this->query_time += timer.Elapsed();
+		timer.Reset();
+
 		for (int j = 0; j < res.Rows(); ++j)
 		{
 			Data data;
@@ -262,7 +277,24 @@ class DBSQL : public Module, public Pipe
 				obj->UpdateCache(data2); /* We know this is the most up to date copy */
 			}
 		}
+
+		this->unserialize_time += timer.Elapsed();
+		this->loaded_objects += res.Rows();
 	}
 };
 
+void ResultSQLSQLInterface::OnResult(const Result &r)
+{
+	SQLSQLInterface::OnResult(r);
+	if (r.GetID() > 0 && this->obj)
+	{
+		this->obj->id = r.GetID();
+
+		/* Updates to the object while it was being inserted were ignored, as it had no id */
+		if (this->obj->GetGeneration() != this->generation)
+			anope_dynamic_static_cast<DBSQL *>(this->owner)->OnSerializableUpdate(this->obj);
+	}
+	delete this;
+}
+
 MODULE_INIT(DBSQL)
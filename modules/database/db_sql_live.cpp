@@ -20,6 +20,8 @@ class DBMySQL : public Module, public Pipe
 	bool ro;
 	bool init;
 	std::set<Serializable *> updated_items;
+	/* Objects being written by OnNotify, objects updated meanwhile are written on the next notify */
+	std::set<Serializable *> processing;
 
 	bool CheckSQL()
 	{
@@ -88,9 +90,11 @@ class DBMySQL : public Module, public Pipe
 		if (!this->CheckInit())
 			return;
 
-		for (std::set<Serializable *>::iterator it = this->updated_items.begin(), it_end = this->updated_items.end(); it != it_end; ++it)
+		this->processing.swap(this->updated_items);
+		while (!this->processing.empty())
 		{
-			Serializable *obj = *it;
+			Serializable *obj = *this->processing.begin();
+			this->processing.erase(this->processing.begin());
 
 			if (obj && this->SQL)
 			{
@@ -98,7 +102,11 @@ class DBMySQL : public Module, public Pipe
 				obj->Serialize(data);
 
 				if (obj->IsCached(data))
+				{
+					/* Nothing has actually changed */
+					obj->Commit();
 					continue;
+				}
 
 				obj->UpdateCache(data);
 
@@ -119,13 +127,20 @@ class DBMySQL : public Module, public Pipe
 				}
 			}
 		}
-
-		this->updated_items.clear();
 	}
 
 	EventReturn OnLoadDatabase() anope_override
 	{
 		init = true;
+
+		/* Updates made before now were ignored, and are not sent again until they are committed */
+		const std::set<Serializable *> &dirty = Serializable::GetDirtyItems();
+		if (!dirty.empty())
+		{
+			this->updated_items.insert(dirty.begin(), dirty.end());
+			this->Notify();
+		}
+
 		return EVENT_STOP;
 	}
 
@@ -167,6 +182,7 @@ class DBMySQL : public Module, public Pipe
 			s_type->objects.erase(obj->id);
 		}
 		this->updated_items.erase(obj);
+		this->processing.erase(obj);
 	}
 
 	void OnSerializeCheck(Serialize::Type *obj) anope_override
@@ -253,9 +269,9 @@ class DBMySQL : public Module, public Pipe
 
 	void OnSerializableUpdate(Serializable *obj) anope_override
 	{
-		if (!this->CheckInit() || obj->IsTSCached())
+		/* This is kept even without SQL, as updates are not sent again until they are committed */
+		if (!this->init)
 			return;
-		obj->UpdateTS();
 		this->updated_items.insert(obj);
 		this->Notify();
 	}
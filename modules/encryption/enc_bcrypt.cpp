@@ -928,7 +928,10 @@ class EBCRYPT : public Module
 			}
 
 			if (ModuleManager::FindFirstOf(ENCRYPTION) != this || (hashrounds && hashrounds != rounds))
+			{
+				nc->QueueUpdate();
 				Anope::Encrypt(req->GetPassword(), nc->pass);
+			}
 			req->Success(this);
 		}
 	}
@@ -60,7 +60,10 @@ class ENone : public Module
 			 * we want to re-encrypt the pass with the new encryption
 			 */
 			if (ModuleManager::FindFirstOf(ENCRYPTION) != this)
+			{
+				nc->QueueUpdate();
 				Anope::Encrypt(req->GetPassword(), nc->pass);
+			}
 			req->Success(this);
 		}
 	}
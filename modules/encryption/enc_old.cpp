@@ -101,7 +101,10 @@ class EOld : public Module
 			 * we want to re-encrypt the pass with the new encryption
 			 */
 			if (ModuleManager::FindFirstOf(ENCRYPTION) != this)
+			{
+				nc->QueueUpdate();
 				Anope::Encrypt(req->GetPassword(), nc->pass);
+			}
 			req->Success(this);
 		}
 	}
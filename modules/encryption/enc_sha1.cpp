@@ -243,7 +243,10 @@ class ESHA1 : public Module
 		if (nc->pass.equals_cs(buf))
 		{
 			if (ModuleManager::FindFirstOf(ENCRYPTION) != this)
+			{
+				nc->QueueUpdate();
 				Anope::Encrypt(req->GetPassword(), nc->pass);
+			}
 			req->Success(this);
 		}
 	}
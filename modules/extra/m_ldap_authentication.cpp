@@ -110,6 +110,7 @@ class IdentifyInterface : public LDAPInterface
 							ii->user->SendMessage(NickServ, _("Your account \002%s\002 has been successfully created."), na->nick.c_str());
 					}
 					// encrypt and store the password in the nickcore
+					na->nc->QueueUpdate();
 					Anope::Encrypt(ii->req->GetPassword(), na->nc->pass);
 
 					na->nc->Extend<Anope::string>("m_ldap_authentication_dn", ii->dn);
@@ -153,6 +154,7 @@ class OnIdentifyInterface : public LDAPInterface
 
 			if (!email.equals_ci(u->Account()->email))
 			{
+				u->Account()->QueueUpdate();
 				u->Account()->email = email;
 				BotInfo *NickServ = Config->GetClient("NickServ");
 				if (NickServ)
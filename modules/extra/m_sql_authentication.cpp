@@ -57,6 +57,7 @@ class SQLAuthenticationResult : public SQL::Interface
 
 		if (!email.empty() && email != na->nc->email)
 		{
+			na->nc->QueueUpdate();
 			na->nc->email = email;
 			if (user && NickServ)
 				user->SendMessage(NickServ, _("Your email has been updated to \002%s\002."), email.c_str());
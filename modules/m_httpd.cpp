@@ -119,16 +119,19 @@ class MyHTTPClient : public HTTPClient
 	{
 		message.content.append(buffer, l);
 
-		for (size_t nl; !this->header_done && (nl = message.content.find('\n')) != Anope::string::npos;)
+		/* Walk the header lines in place and drop them from the buffer once, rather than after each line */
+		size_t start = 0;
+		for (size_t nl; !this->header_done && (nl = message.content.find('\n', start)) != Anope::string::npos; start = nl + 1)
 		{
-			Anope::string token = message.content.substr(0, nl).trim();
-			message.content = message.content.substr(nl + 1);
+			Anope::string token = message.content.substr(start, nl - start).trim();
 
 			if (token.empty())
 				this->header_done = true;
 			else
 				this->Read(token);
 		}
+		if (start)
+			message.content.erase(0, start);
 
 		if (!this->header_done)
 			return true;
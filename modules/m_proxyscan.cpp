@@ -130,7 +130,9 @@ class HTTPProxyConnect : public ProxyConnect, public BufferedSocket
 	bool ProcessRead() anope_override
 	{
 		bool b = BufferedSocket::ProcessRead();
-		if (this->GetLine() == ProxyCheckString)
+		const char *line;
+		size_t len;
+		if (this->GetLine(line, len) && len == ProxyCheckString.length() && !memcmp(line, ProxyCheckString.c_str(), len))
 		{
 			this->Ban();
 			return false;
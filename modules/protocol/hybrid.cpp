@@ -443,45 +443,44 @@ struct IRCDMessageSJoin : IRCDMessage
 {
 	IRCDMessageSJoin(Module *creator) : IRCDMessage(creator, "SJOIN", 2) { SetFlag(IRCDMESSAGE_REQUIRE_SERVER); SetFlag(IRCDMESSAGE_SOFT_LIMIT); }
 
-	void Run(MessageSource &source, const std::vector<Anope::string> &params) anope_override
+	void Run(MessageSource &source, const MessageTokens &params) anope_override
 	{
-		Anope::string modes;
-
-		if (params.size() >= 3)
-			for (unsigned i = 2; i < params.size() - 1; ++i)
-				modes += " " + params[i];
-
-		if (!modes.empty())
-			modes.erase(modes.begin());
+		Anope::string modes = params.Join(2, params.size() - 1);
 
 		std::list<Message::Join::SJoinUser> users;
 
-		spacesepstream sep(params[params.size() - 1]);
+		const MessageTokens::Token &userlist = params[params.size() - 1];
+		MessageTokens::Token word;
 		Anope::string buf;
 
-		while (sep.GetToken(buf))
+		for (size_t pos = 0; userlist.GetToken(pos, word);)
 		{
 			Message::Join::SJoinUser sju;
 
 			/* Get prefixes from the nick */
-			for (char ch; (ch = ModeManager::GetStatusChar(buf[0]));)
-			{
-				buf.erase(buf.begin());
+			size_t i = 0;
+			for (char ch; (ch = ModeManager::GetStatusChar(word[i])); ++i)
 				sju.first.AddMode(ch);
-			}
 
+			buf.str().assign(word.data + i, word.length - i);
 			sju.second = User::Find(buf);
 			if (!sju.second)
 			{
-				Log(LOG_DEBUG) << "SJOIN for nonexistent user " << buf << " on " << params[1];
+				Log(LOG_DEBUG) << "SJOIN for nonexistent user " << buf << " on " << params[1].str();
 				continue;
 			}
 
 			users.push_back(sju);
 		}
 
-		time_t ts = Anope::string(params[0]).is_pos_number_only() ? convertTo<time_t>(params[0]) : Anope::CurTime;
-		Message::Join::SJoin(source, params[1], ts, modes, users);
+		Anope::string chan = params[1].str(), tsbuf = params[0].str();
+		time_t ts = tsbuf.is_pos_number_only() ? convertTo<time_t>(tsbuf) : Anope::CurTime;
+		Message::Join::SJoin(source, chan, ts, modes, users);
+	}
+
+	void Run(MessageSource &source, const std::vector<Anope::string> &params) anope_override
+	{
+		this->Run(source, MessageTokens(params));
 	}
 };
 
@@ -1108,55 +1108,41 @@ struct IRCDMessageSJoin : IRCDMessage
 {
 	IRCDMessageSJoin(Module *creator) : IRCDMessage(creator, "SJOIN", 3) { SetFlag(IRCDMESSAGE_REQUIRE_SERVER); SetFlag(IRCDMESSAGE_SOFT_LIMIT); }
 
-	void Run(MessageSource &source, const std::vector<Anope::string> &params) anope_override
+	void Run(MessageSource &source, const MessageTokens &params) anope_override
 	{
-		Anope::string modes;
-		if (params.size() >= 4)
-			for (unsigned i = 2; i < params.size() - 1; ++i)
-				modes += " " + params[i];
-		if (!modes.empty())
-			modes.erase(modes.begin());
+		Anope::string modes = params.Join(2, params.size() - 1);
 
 		std::list<Anope::string> bans, excepts, invites;
 		std::list<Message::Join::SJoinUser> users;
 
-		spacesepstream sep(params[params.size() - 1]);
+		const MessageTokens::Token &userlist = params[params.size() - 1];
+		MessageTokens::Token word;
 		Anope::string buf;
-		while (sep.GetToken(buf))
+		for (size_t pos = 0; userlist.GetToken(pos, word);)
 		{
 			/* Ban */
-			if (buf[0] == '&')
-			{
-				buf.erase(buf.begin());
-				bans.push_back(buf);
-			}
+			if (word[0] == '&')
+				bans.push_back(Anope::string(word.data + 1, word.length - 1));
 			/* Except */
-			else if (buf[0] == '"')
-			{
-				buf.erase(buf.begin());
-				excepts.push_back(buf);
-			}
+			else if (word[0] == '"')
+				excepts.push_back(Anope::string(word.data + 1, word.length - 1));
 			/* Invex */
-			else if (buf[0] == '\'')
-			{
-				buf.erase(buf.begin());
-				invites.push_back(buf);
-			}
+			else if (word[0] == '\'')
+				invites.push_back(Anope::string(word.data + 1, word.length - 1));
 			else
 			{
 				Message::Join::SJoinUser sju;
 
 				/* Get prefixes from the nick */
-				for (char ch; (ch = ModeManager::GetStatusChar(buf[0]));)
-				{
+				size_t i = 0;
+				for (char ch; (ch = ModeManager::GetStatusChar(word[i])); ++i)
 					sju.first.AddMode(ch);
-					buf.erase(buf.begin());
-				}
 
+				buf.str().assign(word.data + i, word.length - i);
 				sju.second = User::Find(buf);
 				if (!sju.second)
 				{
-					Log(LOG_DEBUG) << "SJOIN for nonexistent user " << buf << " on " << params[1];
+					Log(LOG_DEBUG) << "SJOIN for nonexistent user " << buf << " on " << params[1].str();
 					continue;
 				}
 
@@ -1164,12 +1150,13 @@ struct IRCDMessageSJoin : IRCDMessage
 			}
 		}
 
-		time_t ts = Anope::string(params[0]).is_pos_number_only() ? convertTo<time_t>(params[0]) : Anope::CurTime;
-		Message::Join::SJoin(source, params[1], ts, modes, users);
+		Anope::string chan = params[1].str(), tsbuf = params[0].str();
+		time_t ts = tsbuf.is_pos_number_only() ? convertTo<time_t>(tsbuf) : Anope::CurTime;
+		Message::Join::SJoin(source, chan, ts, modes, users);
 
 		if (!bans.empty() || !excepts.empty() || !invites.empty())
 		{
-			Channel *c = Channel::Find(params[1]);
+			Channel *c = Channel::Find(chan);
 
 			if (!c || c->creation_time != ts)
 				return;
@@ -1189,6 +1176,11 @@ struct IRCDMessageSJoin : IRCDMessage
 					c->SetModeInternal(source, invex, *it);
 		}
 	}
+
+	void Run(MessageSource &source, const std::vector<Anope::string> &params) anope_override
+	{
+		this->Run(source, MessageTokens(params));
+	}
 };
 
 struct IRCDMessageTopic : IRCDMessage
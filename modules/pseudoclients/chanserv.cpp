@@ -26,10 +26,18 @@ class ChanServCore : public Module, public ChanServService
 	ExtensibleItem<bool> inhabit;
 	ExtensibleRef<bool> persist;
 	bool always_lower;
+	/* Channels by when they next need to be checked for expiry */
+	ExpiryQueue<ChannelInfo *> expiries;
+	/* The expire time the channels were scheduled with, if this changes every channel is checked again */
+	time_t scheduled_expire;
+	bool scheduled;
+
+	/* The most channels checked for expiry in one tick */
+	static const unsigned MaxExpireChecks = 10000;
 
  public:
 	ChanServCore(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, PSEUDOCLIENT | VENDOR),
-		ChanServService(this), inhabit(this, "inhabit"), persist("PERSIST"), always_lower(false)
+		ChanServService(this), inhabit(this, "inhabit"), persist("PERSIST"), always_lower(false), scheduled_expire(0), scheduled(false)
 	{
 	}
 
@@ -96,6 +104,11 @@ class ChanServCore : public Module, public ChanServService
 		new ChanServTimer(ChanServ, inhabit, this->owner, c);
 	}
 
+	void ScheduleExpireCheck(ChannelInfo *ci, time_t when) anope_override
+	{
+		expiries.Schedule(ci, when);
+	}
+
 	void OnReload(Configuration::Conf *conf) anope_override
 	{
 		const Anope::string &channick = conf->GetModule(this)->Get<const Anope::string>("client");
@@ -175,6 +188,7 @@ class ChanServCore : public Module, public ChanServService
 				if (newowner)
 				{
 					Log(LOG_NORMAL, "chanserv/drop", ChanServ) << "Transferring foundership of " << ci->name << " from deleted nick " << nc->display << " to " << newowner->display;
+					ci->QueueUpdate();
 					ci->SetFounder(newowner);
 					ci->SetSuccessor(NULL);
 				}
@@ -188,7 +202,10 @@ class ChanServCore : public Module, public ChanServService
 			}
 
 			if (ci->GetSuccessor() == nc)
+			{
+				ci->QueueUpdate();
 				ci->SetSuccessor(NULL);
+			}
 
 			for (unsigned j = 0; j < ci->GetAccessCount(); ++j)
 			{
@@ -215,6 +232,8 @@ class ChanServCore : public Module, public ChanServService
 
 	void OnDelChan(ChannelInfo *ci) anope_override
 	{
+		expiries.Unschedule(ci);
+
 		/* remove access entries that are this channel */
 
 		std::deque<Anope::string> chans;
@@ -300,8 +319,20 @@ class ChanServCore : public Module, public ChanServService
 		}
 	}
 
+	void OnChanSuspend(ChannelInfo *ci) anope_override
+	{
+		expiries.Schedule(ci, Anope::CurTime);
+	}
+
+	void OnChanUnsuspend(ChannelInfo *ci) anope_override
+	{
+		expiries.Schedule(ci, Anope::CurTime);
+	}
+
 	void OnCreateChan(ChannelInfo *ci) anope_override
 	{
+		expiries.Schedule(ci, Anope::CurTime);
+
 		/* Set default chan flags */
 		for (unsigned i = 0; i < defaults.size(); ++i)
 			ci->Extend<bool>(defaults[i].upper());
@@ -337,11 +368,34 @@ class ChanServCore : public Module, public ChanServService
 		if (!chanserv_expire || Anope::NoExpire || Anope::ReadOnly)
 			return;
 
-		for (registered_channel_map::const_iterator it = RegisteredChannelList->begin(), it_end = RegisteredChannelList->end(); it != it_end; )
+		/* Every channel is scheduled for when it is due to expire when we start, or when the expire
+		 * time changes, after which they are scheduled again each time they are checked. Channels
+		 * which have been added without us being told are picked up here too. Suspended channels
+		 * are checked straight away, as their suspension may run out sooner than that.
+		 */
+		if (!scheduled || scheduled_expire != chanserv_expire || expiries.size() != RegisteredChannelList->size())
 		{
-			ChannelInfo *ci = it->second;
-			++it;
+			bool all = !scheduled || scheduled_expire != chanserv_expire;
 
+			for (registered_channel_map::const_iterator it = RegisteredChannelList->begin(), it_end = RegisteredChannelList->end(); it != it_end; ++it)
+			{
+				ChannelInfo *ci = it->second;
+				if (!all && expiries.IsScheduled(ci))
+					continue;
+
+				if (ci->HasExt("CS_SUSPENDED"))
+					expiries.Schedule(ci, Anope::CurTime);
+				else
+					expiries.Schedule(ci, std::max(ci->last_used + chanserv_expire, Anope::CurTime));
+			}
+
+			scheduled = true;
+			scheduled_expire = chanserv_expire;
+		}
+
+		ChannelInfo *ci;
+		for (unsigned checked = 0; checked < MaxExpireChecks && expiries.Next(Anope::CurTime, ci); ++checked)
+		{
 			bool expire = false;
 
 			if (Anope::CurTime - ci->last_used >= chanserv_expire)
@@ -365,6 +419,9 @@ class ChanServCore : public Module, public ChanServService
 				FOREACH_MOD(OnChanExpire, (ci));
 				delete ci;
 			}
+			/* Channels which have been kept from expiring are checked again after another expire period */
+			else
+				expiries.Schedule(ci, ci->last_used + chanserv_expire > Anope::CurTime ? ci->last_used + chanserv_expire : Anope::CurTime + chanserv_expire);
 		}
 	}
 
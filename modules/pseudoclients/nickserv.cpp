@@ -115,6 +115,14 @@ class NickServCore : public Module, public NickServService
 	Reference<BotInfo> NickServ;
 	std::vector<Anope::string> defaults;
 	ExtensibleItem<bool> held, collided;
+	/* Nicks by when they next need to be checked for expiry */
+	ExpiryQueue<NickAlias *> expiries;
+	/* The expire time the nicks were scheduled with, if this changes every nick is checked again */
+	time_t scheduled_expire;
+	bool scheduled;
+
+	/* The most nicks checked for expiry in one tick */
+	static const unsigned MaxExpireChecks = 10000;
 
 	void OnCancel(User *u, NickAlias *na)
 	{
@@ -133,7 +141,7 @@ class NickServCore : public Module, public NickServService
 
  public:
 	NickServCore(const Anope::string &modname, const Anope::string &creator) : Module(modname, creator, PSEUDOCLIENT | VENDOR),
-		NickServService(this), held(this, "HELD"), collided(this, "COLLIDED")
+		NickServService(this), held(this, "HELD"), collided(this, "COLLIDED"), scheduled_expire(0), scheduled(false)
 	{
 	}
 
@@ -279,6 +287,11 @@ class NickServCore : public Module, public NickServService
 		collided.Unset(na); /* clear pending collide */
 	}
 
+	void ScheduleExpireCheck(NickAlias *na, time_t when) anope_override
+	{
+		expiries.Schedule(na, when);
+	}
+
 	void OnReload(Configuration::Conf *conf) anope_override
 	{
 		const Anope::string &nsnick = conf->GetModule(this)->Get<const Anope::string>("client");
@@ -305,6 +318,8 @@ class NickServCore : public Module, public NickServService
 
 	void OnDelNick(NickAlias *na) anope_override
 	{
+		expiries.Unschedule(na);
+
 		User *u = User::Find(na->nick);
 		if (u && u->Account() == na->nc)
 		{
@@ -374,12 +389,30 @@ class NickServCore : public Module, public NickServService
 		}
 	}
 
+	void OnNickRegister(User *u, NickAlias *na, const Anope::string &) anope_override
+	{
+		expiries.Schedule(na, Anope::CurTime);
+	}
+
 	void OnNickGroup(User *u, NickAlias *target) anope_override
 	{
+		expiries.Schedule(target, Anope::CurTime);
+
 		if (!target->nc->HasExt("UNCONFIRMED"))
 			u->SetMode(NickServ, "REGISTERED");
 	}
 
+	void OnNickSuspend(NickAlias *na) anope_override
+	{
+		expiries.Schedule(na, Anope::CurTime);
+	}
+
+	void OnNickUnsuspended(NickAlias *na) anope_override
+	{
+		for (unsigned i = 0; i < na->nc->aliases->size(); ++i)
+			expiries.Schedule(na->nc->aliases->at(i), Anope::CurTime);
+	}
+
 	void OnNickUpdate(User *u) anope_override
 	{
 		for (User::ChanUserList::iterator it = u->chans.begin(), it_end = u->chans.end(); it != it_end; ++it)
@@ -523,15 +556,45 @@ class NickServCore : public Module, public NickServService
 
 		time_t nickserv_expire = Config->GetModule(this)->Get<time_t>("expire", "21d");
 
-		for (nickalias_map::const_iterator it = NickAliasList->begin(), it_end = NickAliasList->end(); it != it_end; )
+		for (user_map::const_iterator it = UserListByNick.begin(), it_end = UserListByNick.end(); it != it_end; ++it)
 		{
-			NickAlias *na = it->second;
-			++it;
+			User *u = it->second;
+			if (!u->IsIdentified(true) && !u->IsRecognized())
+				continue;
 
-			User *u = User::Find(na->nick, true);
-			if (u && (u->IsIdentified(true) || u->IsRecognized()))
+			NickAlias *na = NickAlias::Find(u->nick);
+			if (na)
 				na->last_seen = Anope::CurTime;
+		}
+
+		/* Every nick is scheduled for when it is due to expire when we start, or when the expire time
+		 * changes, after which they are scheduled again each time they are checked. Nicks which have
+		 * been added without us being told are picked up here too. Unconfirmed and suspended nicks
+		 * are checked straight away, as they may be due sooner than that.
+		 */
+		if (!scheduled || scheduled_expire != nickserv_expire || (nickserv_expire && expiries.size() != NickAliasList->size()))
+		{
+			bool all = !scheduled || scheduled_expire != nickserv_expire;
 
+			for (nickalias_map::const_iterator it = NickAliasList->begin(), it_end = NickAliasList->end(); it != it_end; ++it)
+			{
+				NickAlias *na = it->second;
+				if (!all && expiries.IsScheduled(na))
+					continue;
+
+				if (na->nc->HasExt("UNCONFIRMED") || na->nc->HasExt("NS_SUSPENDED"))
+					expiries.Schedule(na, Anope::CurTime);
+				else if (nickserv_expire)
+					expiries.Schedule(na, std::max(na->last_seen + nickserv_expire, Anope::CurTime));
+			}
+
+			scheduled = true;
+			scheduled_expire = nickserv_expire;
+		}
+
+		NickAlias *na;
+		for (unsigned checked = 0; checked < MaxExpireChecks && expiries.Next(Anope::CurTime, na); ++checked)
+		{
 			bool expire = false;
 
 			if (nickserv_expire && Anope::CurTime - na->last_seen >= nickserv_expire)
@@ -545,6 +608,9 @@ class NickServCore : public Module, public NickServService
 				FOREACH_MOD(OnNickExpire, (na));
 				delete na;
 			}
+			/* Nicks which have been kept from expiring are checked again after another expire period */
+			else if (nickserv_expire)
+				expiries.Schedule(na, na->last_seen + nickserv_expire > Anope::CurTime ? na->last_seen + nickserv_expire : Anope::CurTime + nickserv_expire);
 		}
 	}
 
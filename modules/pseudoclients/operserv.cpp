@@ -61,6 +61,17 @@ class SGLineManager : public XLineManager
 
 		return false;
 	}
+
+	Anope::string GetIndexMask(const XLine *x) anope_override
+	{
+		return x->IsRegex() ? "" : x->GetHost();
+	}
+
+	void GetIndexKeys(User *u, std::vector<Anope::string> &keys) anope_override
+	{
+		keys.push_back(u->host);
+		keys.push_back(u->ip.addr());
+	}
 };
 
 class SQLineManager : public XLineManager
@@ -120,6 +131,16 @@ class SQLineManager : public XLineManager
 		return Anope::Match(u->nick, x->mask);
 	}
 
+	Anope::string GetIndexMask(const XLine *x) anope_override
+	{
+		return x->IsRegex() ? "" : x->mask;
+	}
+
+	void GetIndexKeys(User *u, std::vector<Anope::string> &keys) anope_override
+	{
+		keys.push_back(u->nick);
+	}
+
 	XLine *CheckChannel(Channel *c)
 	{
 		for (std::vector<XLine *>::const_iterator it = this->GetList().begin(), it_end = this->GetList().end(); it != it_end; ++it)
@@ -180,6 +201,16 @@ class SNLineManager : public XLineManager
 			return x->regex->Matches(u->realname);
 		return Anope::Match(u->realname, x->mask, false, true);
 	}
+
+	Anope::string GetIndexMask(const XLine *x) anope_override
+	{
+		return x->IsRegex() ? "" : x->mask;
+	}
+
+	void GetIndexKeys(User *u, std::vector<Anope::string> &keys) anope_override
+	{
+		keys.push_back(u->realname);
+	}
 };
 
 class OperServCore : public Module
@@ -23,6 +23,7 @@ bool WebCPanel::NickServ::Info::OnRequest(HTTPProvider *server, const Anope::str
 					replacements["ERRORS"] = "Invalid email";
 				else
 				{
+					na->nc->QueueUpdate();
 					na->nc->email = message.post_data["email"];
 					replacements["MESSAGES"] = "Email updated";
 				}
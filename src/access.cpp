@@ -59,7 +59,7 @@ static struct
 	{"VOICEME", _("Allowed to (de)voice him/herself")}
 };
 
-Privilege::Privilege(const Anope::string &n, const Anope::string &d, int r) : name(n), desc(d), rank(r)
+Privilege::Privilege(const Anope::string &n, const Anope::string &d, int r) : name(n), desc(d), rank(r), id(PrivilegeManager::GetPrivilegeId(n))
 {
 	if (this->desc.empty())
 		for (unsigned j = 0; j < sizeof(descriptions) / sizeof(*descriptions); ++j)
@@ -73,6 +73,19 @@ bool Privilege::operator==(const Privilege &other) const
 }
 
 std::vector<Privilege> PrivilegeManager::Privileges;
+Anope::hash_map<unsigned> PrivilegeManager::Ids;
+std::vector<int> PrivilegeManager::Positions;
+unsigned PrivilegeManager::Generation = 1;
+
+void PrivilegeManager::Update()
+{
+	Positions.assign(Ids.size(), -1);
+	/* Later privileges take precedence, like with FindPrivilege before it was indexed */
+	for (unsigned i = 0; i < Privileges.size(); ++i)
+		Positions[Privileges[i].id] = i;
+
+	ClearCache();
+}
 
 void PrivilegeManager::AddPrivilege(Privilege p)
 {
@@ -86,6 +99,7 @@ void PrivilegeManager::AddPrivilege(Privilege p)
 	}
 
 	Privileges.insert(Privileges.begin() + i, p);
+	Update();
 }
 
 void PrivilegeManager::RemovePrivilege(Privilege &p)
@@ -93,6 +107,7 @@ void PrivilegeManager::RemovePrivilege(Privilege &p)
 	std::vector<Privilege>::iterator it = std::find(Privileges.begin(), Privileges.end(), p);
 	if (it != Privileges.end())
 		Privileges.erase(it);
+	Update();
 
 	for (registered_channel_map::const_iterator cit = RegisteredChannelList->begin(), cit_end = RegisteredChannelList->end(); cit != cit_end; ++cit)
 	{
@@ -103,10 +118,10 @@ void PrivilegeManager::RemovePrivilege(Privilege &p)
 
 Privilege *PrivilegeManager::FindPrivilege(const Anope::string &name)
 {
-	for (unsigned i = Privileges.size(); i > 0; --i)
-		if (Privileges[i - 1].name.equals_ci(name))
-			return &Privileges[i - 1];
-	return NULL;
+	Anope::hash_map<unsigned>::const_iterator it = Ids.find(name);
+	if (it == Ids.end() || it->second >= Positions.size() || Positions[it->second] < 0)
+		return NULL;
+	return &Privileges[Positions[it->second]];
 }
 
 std::vector<Privilege> &PrivilegeManager::GetPrivileges()
@@ -117,6 +132,29 @@ std::vector<Privilege> &PrivilegeManager::GetPrivileges()
 void PrivilegeManager::ClearPrivileges()
 {
 	Privileges.clear();
+	Update();
+}
+
+unsigned PrivilegeManager::GetPrivilegeId(const Anope::string &name)
+{
+	Anope::hash_map<unsigned>::const_iterator it = Ids.find(name);
+	if (it != Ids.end())
+		return it->second;
+
+	unsigned id = Ids.size();
+	Ids[name] = id;
+	return id;
+}
+
+void PrivilegeManager::ClearCache()
+{
+	if (++Generation == 0)
+		++Generation;
+}
+
+unsigned PrivilegeManager::GetGeneration()
+{
+	return Generation;
 }
 
 AccessProvider::AccessProvider(Module *o, const Anope::string &n) : Service(o, "AccessProvider", n)
@@ -138,7 +176,7 @@ const std::list<AccessProvider *>& AccessProvider::GetProviders()
 	return Providers;
 }
 
-ChanAccess::ChanAccess(AccessProvider *p) : Serializable("ChanAccess"), provider(p)
+ChanAccess::ChanAccess(AccessProvider *p) : Serializable("ChanAccess"), privileges_generation(0), provider(p)
 {
 }
 
@@ -149,6 +187,7 @@ ChanAccess::~ChanAccess()
 		std::vector<ChanAccess *>::iterator it = std::find(this->ci->access->begin(), this->ci->access->end(), this);
 		if (it != this->ci->access->end())
 			this->ci->access->erase(it);
+		this->ci->AccessChanged();
 
 		if (*nc != NULL)
 			nc->RemoveChannelReference(this->ci);
@@ -163,6 +202,9 @@ ChanAccess::~ChanAccess()
 
 void ChanAccess::SetMask(const Anope::string &m, ChannelInfo *c)
 {
+	if (this->ci && this->ci != c)
+		this->ci->AccessChanged();
+
 	if (*nc != NULL)
 		nc->RemoveChannelReference(this->ci);
 	else if (!this->mask.empty())
@@ -190,6 +232,8 @@ void ChanAccess::SetMask(const Anope::string &m, ChannelInfo *c)
 		if (targci != NULL)
 			targci->AddChannelReference(ci->name);
 	}
+
+	ci->AccessChanged();
 }
 
 const Anope::string &ChanAccess::Mask() const
@@ -205,23 +249,26 @@ NickCore *ChanAccess::GetAccount() const
 	return nc;
 }
 
+static const Serialize::Key provider_key("provider"), ci_key("ci"), mask_key("mask"), creator_key("creator"),
+	last_seen_key("last_seen", Serialize::Data::DT_INT), created_key("created", Serialize::Data::DT_INT), data_key("data");
+
 void ChanAccess::Serialize(Serialize::Data &data) const
 {
-	data["provider"] << this->provider->name;
-	data["ci"] << this->ci->name;
-	data["mask"] << this->Mask();
-	data["creator"] << this->creator;
-	data.SetType("last_seen", Serialize::Data::DT_INT); data["last_seen"] << this->last_seen;
-	data.SetType("created", Serialize::Data::DT_INT); data["created"] << this->created;
-	data["data"] << this->AccessSerialize();
+	data.Set(provider_key, this->provider->name);
+	data.Set(ci_key, this->ci->name);
+	data.Set(mask_key, this->Mask());
+	data.Set(creator_key, this->creator);
+	data.Set(last_seen_key, this->last_seen);
+	data.Set(created_key, this->created);
+	data.Set(data_key, this->AccessSerialize());
 }
 
 Serializable* ChanAccess::Unserialize(Serializable *obj, Serialize::Data &data)
 {
 	Anope::string provider, chan;
 
-	data["provider"] >> provider;
-	data["ci"] >> chan;
+	data.Get(provider_key, provider);
+	data.Get(ci_key, chan);
 
 	ServiceReference<AccessProvider> aprovider("AccessProvider", provider);
 	ChannelInfo *ci = ChannelInfo::Find(chan);
@@ -235,15 +282,16 @@ Serializable* ChanAccess::Unserialize(Serializable *obj, Serialize::Data &data)
 		access = aprovider->Create();
 	access->ci = ci;
 	Anope::string m;
-	data["mask"] >> m;
+	data.Get(mask_key, m);
 	access->SetMask(m, ci);
-	data["creator"] >> access->creator;
-	data["last_seen"] >> access->last_seen;
-	data["created"] >> access->created;
+	data.Get(creator_key, access->creator);
+	data.Get(last_seen_key, access->last_seen);
+	data.Get(created_key, access->created);
 
 	Anope::string adata;
-	data["data"] >> adata;
+	data.Get(data_key, adata);
 	access->AccessUnserialize(adata);
+	access->privileges_generation = 0;
 
 	if (!obj)
 		ci->AddAccess(access);
@@ -284,13 +332,34 @@ bool ChanAccess::Matches(const User *u, const NickCore *acc, ChannelInfo* &next)
 	return false;
 }
 
+bool ChanAccess::HasPrivId(unsigned priv) const
+{
+	if (this->privileges_generation != PrivilegeManager::GetGeneration())
+	{
+		const std::vector<Privilege> &privs = PrivilegeManager::GetPrivileges();
+
+		this->privileges.clear();
+		for (unsigned i = 0; i < privs.size(); ++i)
+		{
+			const Privilege &p = privs[i];
+			if (p.id >= this->privileges.size())
+				this->privileges.resize(p.id + 1);
+			this->privileges[p.id] = this->HasPriv(p.name);
+		}
+
+		this->privileges_generation = PrivilegeManager::GetGeneration();
+	}
+
+	return priv < this->privileges.size() && this->privileges[priv];
+}
+
 bool ChanAccess::operator>(const ChanAccess &other) const
 {
 	const std::vector<Privilege> &privs = PrivilegeManager::GetPrivileges();
 	for (unsigned i = privs.size(); i > 0; --i)
 	{
-		bool this_p = this->HasPriv(privs[i - 1].name),
-			other_p = other.HasPriv(privs[i - 1].name);
+		bool this_p = this->HasPrivId(privs[i - 1].id),
+			other_p = other.HasPrivId(privs[i - 1].id);
 
 		if (!this_p && !other_p)
 			continue;
@@ -306,8 +375,8 @@ bool ChanAccess::operator<(const ChanAccess &other) const
 	const std::vector<Privilege> &privs = PrivilegeManager::GetPrivileges();
 	for (unsigned i = privs.size(); i > 0; --i)
 	{
-		bool this_p = this->HasPriv(privs[i - 1].name),
-			other_p = other.HasPriv(privs[i - 1].name);
+		bool this_p = this->HasPrivId(privs[i - 1].id),
+			other_p = other.HasPrivId(privs[i - 1].id);
 
 		if (!this_p && !other_p)
 			continue;
@@ -335,7 +404,8 @@ AccessGroup::AccessGroup()
 	this->super_admin = this->founder = false;
 }
 
-static bool HasPriv(const ChanAccess::Path &path, const Anope::string &name)
+/* priv is the privilege called name if it is registered, whether entries have it is then remembered */
+static bool HasPriv(const ChanAccess::Path &path, const Anope::string &name, const Privilege *priv)
 {
 	if (path.empty())
 		return false;
@@ -347,7 +417,7 @@ static bool HasPriv(const ChanAccess::Path &path, const Anope::string &name)
 		EventReturn MOD_RESULT;
 		FOREACH_RESULT(OnCheckPriv, MOD_RESULT, (access, name));
 
-		if (MOD_RESULT != EVENT_ALLOW && !access->HasPriv(name))
+		if (MOD_RESULT != EVENT_ALLOW && !(priv ? access->HasPrivId(priv->id) : access->HasPriv(name)))
 			return false;
 	}
 
@@ -375,11 +445,13 @@ bool AccessGroup::HasPriv(const Anope::string &name) const
 	if (MOD_RESULT != EVENT_CONTINUE)
 		return MOD_RESULT == EVENT_ALLOW;
 
+	const Privilege *priv = PrivilegeManager::FindPrivilege(name);
+
 	for (unsigned int i = paths.size(); i > 0; --i)
 	{
 		const ChanAccess::Path &path = paths[i - 1];
 
-		if (::HasPriv(path, name))
+		if (::HasPriv(path, name, priv))
 			return true;
 	}
 
@@ -73,14 +73,16 @@ BotInfo::~BotInfo()
 		BotListByUID->erase(this->uid);
 }
 
+static const Serialize::Key nick_key("nick"), user_key("user"), host_key("host"), realname_key("realname"), created_key("created"), oper_only_key("oper_only");
+
 void BotInfo::Serialize(Serialize::Data &data) const
 {
-	data["nick"] << this->nick;
-	data["user"] << this->ident;
-	data["host"] << this->host;
-	data["realname"] << this->realname;
-	data["created"] << this->created;
-	data["oper_only"] << this->oper_only;
+	data.Set(nick_key, this->nick);
+	data.Set(user_key, this->ident);
+	data.Set(host_key, this->host);
+	data.Set(realname_key, this->realname);
+	data.Set(created_key, this->created);
+	data.Set(oper_only_key, this->oper_only);
 
 	Extensible::ExtensibleSerialize(this, this, data);
 }
@@ -89,10 +91,10 @@ Serializable* BotInfo::Unserialize(Serializable *obj, Serialize::Data &data)
 {
 	Anope::string nick, user, host, realname, flags;
 
-	data["nick"] >> nick;
-	data["user"] >> user;
-	data["host"] >> host;
-	data["realname"] >> realname;
+	data.Get(nick_key, nick);
+	data.Get(user_key, user);
+	data.Get(host_key, host);
+	data.Get(realname_key, realname);
 
 	BotInfo *bi;
 	if (obj)
@@ -100,8 +102,8 @@ Serializable* BotInfo::Unserialize(Serializable *obj, Serialize::Data &data)
 	else if (!(bi = BotInfo::Find(nick, true)))
 		bi = new BotInfo(nick, user, host, realname);
 
-	data["created"] >> bi->created;
-	data["oper_only"] >> bi->oper_only;
+	data.Get(created_key, bi->created);
+	data.Get(oper_only_key, bi->oper_only);
 
 	Extensible::ExtensibleUnserialize(bi, bi, data);
 
@@ -161,6 +163,7 @@ void BotInfo::Assign(User *u, ChannelInfo *ci)
 	if (ci->bi)
 		ci->bi->UnAssign(u, ci);
 
+	ci->QueueUpdate();
 	ci->bi = this;
 	this->channels->insert(ci);
 
@@ -182,6 +185,7 @@ void BotInfo::UnAssign(User *u, ChannelInfo *ci)
 			ci->bi->Part(ci->c);
 	}
 
+	ci->QueueUpdate();
 	ci->bi = NULL;
 	this->channels->erase(ci);
 }
@@ -28,6 +28,111 @@
 channel_map ChannelList;
 std::vector<Channel *> Channel::deleting;
 
+struct Channel::ListModeIndex
+{
+	/* Every entry, by mask */
+	Anope::hash_map<Entry *> entries;
+	/* Entries for a host without wildcards, by host */
+	TR1NS::unordered_multimap<Anope::string, Entry *, Anope::hash_ci, Anope::compare> hosts;
+	/* Entries for a CIDR range */
+	CIDRTree<Entry *> ranges;
+	/* Everything else, such as wildcard hosts and extbans, which every user has to be checked against */
+	std::vector<Entry *> others;
+
+	~ListModeIndex()
+	{
+		for (Anope::hash_map<Entry *>::iterator it = this->entries.begin(), it_end = this->entries.end(); it != it_end; ++it)
+			delete it->second;
+	}
+
+	static bool IsRange(const Entry *e)
+	{
+		switch (e->family)
+		{
+			case AF_INET:
+				return e->cidr_len <= 32;
+			case AF_INET6:
+				return e->cidr_len <= 128;
+		}
+		return false;
+	}
+
+	void Add(const Anope::string &mode, const Anope::string &mask)
+	{
+		Entry *&e = this->entries[mask];
+		if (e)
+			return;
+		e = new Entry(mode, mask);
+
+		if ((IRCD && IRCD->IsExtbanValid(mask)) || e->host.empty() || e->host.find_first_of("*?") != Anope::string::npos || (e->cidr_len && !IsRange(e)))
+		{
+			this->others.push_back(e);
+			return;
+		}
+
+		/* Ranges are also matched as a host against users who can't be matched by IP */
+		this->hosts.insert(std::make_pair(e->host, e));
+		if (e->cidr_len)
+			this->ranges.insert(cidr(e->host, e->cidr_len), e);
+	}
+
+	void Remove(const Anope::string &mask)
+	{
+		Anope::hash_map<Entry *>::iterator it = this->entries.find(mask);
+		if (it == this->entries.end())
+			return;
+		Entry *e = it->second;
+		this->entries.erase(it);
+
+		std::vector<Entry *>::iterator oit = std::find(this->others.begin(), this->others.end(), e);
+		if (oit != this->others.end())
+			this->others.erase(oit);
+		else
+		{
+			typedef TR1NS::unordered_multimap<Anope::string, Entry *, Anope::hash_ci, Anope::compare>::iterator host_iterator;
+			std::pair<host_iterator, host_iterator> range = this->hosts.equal_range(e->host);
+			for (host_iterator hit = range.first; hit != range.second; ++hit)
+				if (hit->second == e)
+				{
+					this->hosts.erase(hit);
+					break;
+				}
+			if (e->cidr_len)
+				this->ranges.erase(cidr(e->host, e->cidr_len), e);
+		}
+
+		delete e;
+	}
+
+	/* Finds the entries a user could match */
+	void Find(User *u, std::vector<Entry *> &found) const
+	{
+		found = this->others;
+
+		const Anope::string *keys[] = { &u->GetDisplayedHost(), &u->GetCloakedHost(), &u->host };
+		for (unsigned i = 0; i < sizeof(keys) / sizeof(*keys); ++i)
+		{
+			typedef TR1NS::unordered_multimap<Anope::string, Entry *, Anope::hash_ci, Anope::compare>::const_iterator host_iterator;
+			std::pair<host_iterator, host_iterator> range = this->hosts.equal_range(*keys[i]);
+			for (host_iterator it = range.first; it != range.second; ++it)
+				found.push_back(it->second);
+		}
+
+		if (!this->hosts.empty())
+		{
+			typedef TR1NS::unordered_multimap<Anope::string, Entry *, Anope::hash_ci, Anope::compare>::const_iterator host_iterator;
+			std::pair<host_iterator, host_iterator> range = this->hosts.equal_range(u->ip.addr());
+			for (host_iterator it = range.first; it != range.second; ++it)
+				found.push_back(it->second);
+		}
+
+		this->ranges.find(u->ip, found);
+
+		std::sort(found.begin(), found.end());
+		found.erase(std::unique(found.begin(), found.end()), found.end());
+	}
+};
+
 Channel::Channel(const Anope::string &nname, time_t ts)
 {
 	if (nname.empty())
@@ -64,12 +169,18 @@ Channel::~Channel()
 	if (this->ci)
 		this->ci->c = NULL;
 
+	for (std::map<Anope::string, ListModeIndex *>::iterator it = this->list_indexes.begin(), it_end = this->list_indexes.end(); it != it_end; ++it)
+		delete it->second;
+
 	ChannelList.erase(this->name);
 }
 
 void Channel::Reset()
 {
 	this->modes.clear();
+	for (std::map<Anope::string, ListModeIndex *>::iterator it = this->list_indexes.begin(), it_end = this->list_indexes.end(); it != it_end; ++it)
+		delete it->second;
+	this->list_indexes.clear();
 
 	for (ChanUserList::const_iterator it = this->users.begin(), it_end = this->users.end(); it != it_end; ++it)
 	{
@@ -203,9 +314,13 @@ size_t Channel::HasMode(const Anope::string &mname, const Anope::string &param)
 {
 	if (param.empty())
 		return modes.count(mname);
-	std::vector<Anope::string> v = this->GetModeList(mname);
-	for (unsigned int i = 0; i < v.size(); ++i)
-		if (v[i].equals_ci(param))
+
+	std::map<Anope::string, ListModeIndex *>::const_iterator lit = this->list_indexes.find(mname);
+	if (lit != this->list_indexes.end())
+		return lit->second->entries.count(param);
+
+	for (ModeList::const_iterator it = modes.lower_bound(mname), it_end = modes.upper_bound(mname); it != it_end; ++it)
+		if (it->second.equals_ci(param))
 			return 1;
 	return 0;
 }
@@ -306,6 +421,14 @@ void Channel::SetModeInternal(MessageSource &setter, ChannelMode *ocm, const Ano
 
 	this->modes.insert(std::make_pair(cm->name, param));
 
+	if (cm->type == MODE_LIST)
+	{
+		ListModeIndex *&index = this->list_indexes[cm->name];
+		if (!index)
+			index = new ListModeIndex();
+		index->Add(cm->name, param);
+	}
+
 	if (param.empty() && cm->type != MODE_REGULAR)
 	{
 		Log() << "Channel::SetModeInternal() mode " << cm->mchar << " for " << this->name << " with no paramater, but is a param mode";
@@ -378,6 +501,17 @@ void Channel::RemoveModeInternal(MessageSource &setter, ChannelMode *ocm, const
 				this->modes.erase(it);
 				break;
 			}
+
+		std::map<Anope::string, ListModeIndex *>::iterator lit = this->list_indexes.find(cm->name);
+		if (lit != this->list_indexes.end())
+		{
+			lit->second->Remove(param);
+			if (lit->second->entries.empty())
+			{
+				delete lit->second;
+				this->list_indexes.erase(lit);
+			}
+		}
 	}
 	else
 		this->modes.erase(cm->name);
@@ -725,16 +859,15 @@ void Channel::SetModesInternal(MessageSource &source, const Anope::string &mode,
 
 bool Channel::MatchesList(User *u, const Anope::string &mode)
 {
-	if (!this->HasMode(mode))
+	std::map<Anope::string, ListModeIndex *>::const_iterator it = this->list_indexes.find(mode);
+	if (it == this->list_indexes.end())
 		return false;
 
-	std::vector<Anope::string> v = this->GetModeList(mode);
-	for (unsigned i = 0; i < v.size(); ++i)
-	{
-		Entry e(mode, v[i]);
-		if (e.Matches(u))
+	std::vector<Entry *> entries;
+	it->second->Find(u, entries);
+	for (unsigned i = 0; i < entries.size(); ++i)
+		if (entries[i]->Matches(u))
 			return true;
-	}
 
 	return false;
 }
@@ -875,23 +1008,23 @@ void Channel::SetCorrectModes(User *user, bool give_modes)
 
 bool Channel::Unban(User *u, const Anope::string &mode, bool full)
 {
-	if (!this->HasMode(mode))
+	std::map<Anope::string, ListModeIndex *>::const_iterator it = this->list_indexes.find(mode);
+	if (it == this->list_indexes.end())
 		return false;
 
-	bool ret = false;
+	std::vector<Entry *> entries;
+	it->second->Find(u, entries);
 
-	std::vector<Anope::string> v = this->GetModeList(mode);
-	for (unsigned int i = 0; i < v.size(); ++i)
-	{
-		Entry ban(mode, v[i]);
-		if (ban.Matches(u, full))
-		{
-			this->RemoveMode(NULL, mode, ban.GetMask());
-			ret = true;
-		}
-	}
+	/* Removing the modes removes their entries, so find all of the masks first */
+	std::vector<Anope::string> masks;
+	for (unsigned i = 0; i < entries.size(); ++i)
+		if (entries[i]->Matches(u, full))
+			masks.push_back(entries[i]->GetMask());
+
+	for (unsigned i = 0; i < masks.size(); ++i)
+		this->RemoveMode(NULL, mode, masks[i]);
 
-	return ret;
+	return !masks.empty();
 }
 
 bool Channel::CheckKick(User *user)
@@ -16,6 +16,7 @@
 #include "opertype.h"
 #include "channels.h"
 #include "hashcomp.h"
+#include "language.h"
 
 using namespace Configuration;
 
@@ -591,6 +592,9 @@ void Conf::Post(Conf *old)
 			}
 		}
 	}
+
+	/* Reload the language files, the configured languages may have changed */
+	Language::InitLanguages();
 }
 
 Block *Conf::GetModule(Module *m)
@@ -25,6 +25,13 @@ Extensible::~Extensible()
 	UnsetExtensibles();
 }
 
+void Extensible::QueueExtensibleUpdate()
+{
+	Serializable *s = dynamic_cast<Serializable *>(this);
+	if (s)
+		s->QueueUpdate();
+}
+
 void Extensible::UnsetExtensibles()
 {
 	while (!extension_items.empty())
@@ -15,44 +15,277 @@
 #include "config.h"
 #include "language.h"
 
-#if GETTEXT_FOUND
-# include <libintl.h>
-#endif
+#include <fstream>
 
 std::vector<Anope::string> Language::Languages;
 std::vector<Anope::string> Language::Domains;
 
+/* Translations are looked up in the compiled gettext catalogs (.mo files), which
+ * are read into memory once when the languages or a module's domain are loaded.
+ * Each language has one hash table over all of its catalogs, so translating a
+ * string never has to touch the process locale.
+ */
+
+/* One .mo file */
+struct Catalog
+{
+	Anope::string domain;
+	std::vector<char> data;
+	/* Message ids and their translations, pointing into data */
+	std::vector<std::pair<const char *, const char *> > messages;
+};
+
+struct CatalogEntry
+{
+	size_t hash;
+	const char *msgid;
+	const char *msgstr;
+
+	CatalogEntry() : hash(0), msgid(NULL), msgstr(NULL) { }
+};
+
+/* All of the catalogs of one language, "anope" first and then the module domains */
+struct LanguageCatalogs
+{
+	Anope::string name;
+	std::vector<Catalog *> catalogs;
+	/* Open addressed, always a power of two in size and less than half full */
+	std::vector<CatalogEntry> index;
+
+	~LanguageCatalogs()
+	{
+		for (unsigned i = 0; i < catalogs.size(); ++i)
+			delete catalogs[i];
+	}
+};
+
+static std::vector<LanguageCatalogs *> LanguageList;
+/* The language to use if no default language is configured */
+static Anope::string SystemLanguage;
+
+static inline size_t HashMessage(const char *s)
+{
+	size_t h = 2166136261u;
+	for (; *s; ++s)
+		h = (h ^ static_cast<unsigned char>(*s)) * 16777619u;
+	return h;
+}
+
+static inline uint32_t ReadWord(const std::vector<char> &data, size_t offset, bool swap)
+{
+	const unsigned char *p = reinterpret_cast<const unsigned char *>(&data[offset]);
+	if (swap)
+		return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+	return p[0] | (p[1] << 8) | (p[2] << 16) | (p[3] << 24);
+}
+
+static Catalog *LoadCatalog(const Anope::string &language, const Anope::string &domain)
+{
+	/* Remove .UTF-8 or any other suffix, and fall back to just the language if there is no catalog for the territory */
+	Anope::string lang;
+	sepstream(language, '.').GetToken(lang);
+
+	Anope::string file = Anope::LocaleDir + "/" + lang + "/LC_MESSAGES/" + domain + ".mo";
+	size_t sep = lang.find('_');
+	if (!Anope::IsFile(file) && sep != Anope::string::npos)
+		file = Anope::LocaleDir + "/" + lang.substr(0, sep) + "/LC_MESSAGES/" + domain + ".mo";
+
+	std::ifstream stream(file.c_str(), std::ios_base::in | std::ios_base::binary);
+	if (!stream.is_open())
+		return NULL;
+
+	Catalog *c = new Catalog();
+	c->domain = domain;
+	c->data.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+	/* Terminate the data so a truncated file can not run a string off of the end */
+	c->data.push_back(0);
+
+	const std::vector<char> &data = c->data;
+	size_t size = data.size() - 1;
+	bool swap = false;
+
+	if (size < 20)
+	{
+		delete c;
+		return NULL;
+	}
+	else if (ReadWord(data, 0, false) == 0x950412de)
+		swap = false;
+	else if (ReadWord(data, 0, true) == 0x950412de)
+		swap = true;
+	else
+	{
+		Log() << "Language file " << file << " is not a valid message catalog";
+		delete c;
+		return NULL;
+	}
+
+	uint32_t count = ReadWord(data, 8, swap), msgids = ReadWord(data, 12, swap), msgstrs = ReadWord(data, 16, swap);
+	if (msgids > size || msgstrs > size || count > (size - msgids) / 8 || count > (size - msgstrs) / 8)
+	{
+		Log() << "Language file " << file << " is corrupt";
+		delete c;
+		return NULL;
+	}
+
+	c->messages.reserve(count);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		uint32_t id_len = ReadWord(data, msgids + i * 8, swap), idoff = ReadWord(data, msgids + i * 8 + 4, swap),
+			str_len = ReadWord(data, msgstrs + i * 8, swap), stroff = ReadWord(data, msgstrs + i * 8 + 4, swap);
+
+		if (idoff > size || id_len > size - idoff || stroff > size || str_len > size - stroff)
+		{
+			Log() << "Language file " << file << " is corrupt";
+			delete c;
+			return NULL;
+		}
+
+		/* Skip the header, which has an empty message id, and untranslated messages */
+		if (!id_len || !str_len)
+			continue;
+
+		c->messages.push_back(std::make_pair(&data[idoff], &data[stroff]));
+	}
+
+	Log(LOG_DEBUG) << "Loaded " << c->messages.size() << " translations from " << file;
+	return c;
+}
+
+static void Reindex(LanguageCatalogs *lc)
+{
+	size_t count = 0;
+	for (unsigned i = 0; i < lc->catalogs.size(); ++i)
+		count += lc->catalogs[i]->messages.size();
+
+	size_t size = 16;
+	while (size < count * 2)
+		size <<= 1;
+
+	lc->index.clear();
+	lc->index.resize(size);
+
+	for (unsigned i = 0; i < lc->catalogs.size(); ++i)
+	{
+		const Catalog *c = lc->catalogs[i];
+
+		for (unsigned j = 0; j < c->messages.size(); ++j)
+		{
+			const char *msgid = c->messages[j].first;
+			size_t hash = HashMessage(msgid);
+
+			for (size_t k = hash & (size - 1);; k = (k + 1) & (size - 1))
+			{
+				CatalogEntry &e = lc->index[k];
+
+				if (e.msgid == NULL)
+				{
+					e.hash = hash;
+					e.msgid = msgid;
+					e.msgstr = c->messages[j].second;
+					break;
+				}
+				/* Earlier catalogs take priority, as when searching the domains in order */
+				else if (e.hash == hash && !strcmp(e.msgid, msgid))
+					break;
+			}
+		}
+	}
+}
+
 void Language::InitLanguages()
 {
-#if GETTEXT_FOUND
 	Log(LOG_DEBUG) << "Initializing Languages...";
 
+	for (unsigned i = 0; i < LanguageList.size(); ++i)
+		delete LanguageList[i];
+	LanguageList.clear();
 	Languages.clear();
 
-	if (!bindtextdomain("anope", Anope::LocaleDir.c_str()))
-		Log() << "Error calling bindtextdomain, " << Anope::LastError();
-	else
-		Log(LOG_DEBUG) << "Successfully bound anope to " << Anope::LocaleDir;
-
-	setlocale(LC_ALL, "");
+	/* This is what gettext would have used for the default language */
+	const char *env_vars[] = { "LANGUAGE", "LC_ALL", "LC_MESSAGES", "LANG" };
+	SystemLanguage.clear();
+	for (unsigned i = 0; SystemLanguage.empty() && i < sizeof(env_vars) / sizeof(*env_vars); ++i)
+	{
+		const char *value = getenv(env_vars[i]);
+		if (value != NULL)
+			sepstream(value, ':').GetToken(SystemLanguage);
+	}
 
 	spacesepstream sep(Config->GetBlock("options")->Get<const Anope::string>("languages"));
 	Anope::string language;
 	while (sep.GetToken(language))
 	{
-		const Anope::string &lang_name = Translate(language.c_str(), _("English"));
-		if (lang_name == "English")
+		Catalog *c = LoadCatalog(language, "anope");
+		if (!c)
 		{
 			Log() << "Unable to use language " << language;
 			continue;
 		}
 
+		LanguageCatalogs *lc = new LanguageCatalogs();
+		lc->name = language;
+		lc->catalogs.push_back(c);
+
+		for (unsigned i = 0; i < Domains.size(); ++i)
+		{
+			c = LoadCatalog(language, Domains[i]);
+			if (c)
+				lc->catalogs.push_back(c);
+		}
+
+		Reindex(lc);
+
 		Log(LOG_DEBUG) << "Found language " << language;
+		LanguageList.push_back(lc);
 		Languages.push_back(language);
 	}
-#else
-	Log() << "Unable to initialize languages, gettext is not installed";
-#endif
+}
+
+bool Language::AddDomain(const Anope::string &domain)
+{
+	bool found = false;
+
+	for (unsigned i = 0; i < LanguageList.size(); ++i)
+	{
+		LanguageCatalogs *lc = LanguageList[i];
+
+		Catalog *c = LoadCatalog(lc->name, domain);
+		if (!c)
+			continue;
+
+		Log() << "Found language file " << lc->name << " for " << domain;
+		lc->catalogs.push_back(c);
+		Reindex(lc);
+		found = true;
+	}
+
+	if (found)
+		Domains.push_back(domain);
+
+	return found;
+}
+
+void Language::RemoveDomain(const Anope::string &domain)
+{
+	std::vector<Anope::string>::iterator it = std::find(Domains.begin(), Domains.end(), domain);
+	if (it == Domains.end())
+		return;
+	Domains.erase(it);
+
+	for (unsigned i = 0; i < LanguageList.size(); ++i)
+	{
+		LanguageCatalogs *lc = LanguageList[i];
+
+		for (unsigned j = lc->catalogs.size(); j > 0; --j)
+			if (lc->catalogs[j - 1]->domain == domain)
+			{
+				delete lc->catalogs[j - 1];
+				lc->catalogs.erase(lc->catalogs.begin() + j - 1);
+			}
+
+		Reindex(lc);
+	}
 }
 
 const char *Language::Translate(const char *string)
@@ -73,12 +306,6 @@ const char *Language::Translate(const NickCore *nc, const char *string)
 	return Translate(nc ? nc->language.c_str() : "", string);
 }
 
-#if GETTEXT_FOUND
-
-#ifdef __USE_GNU_GETTEXT
-extern "C" int _nl_msg_cat_cntr;
-#endif
-
 const char *Language::Translate(const char *lang, const char *string)
 {
 	if (!string || !*string)
@@ -86,42 +313,27 @@ const char *Language::Translate(const char *lang, const char *string)
 
 	if (!lang || !*lang)
 		lang = Config->DefLanguage.c_str();
+	if (!*lang)
+		lang = SystemLanguage.c_str();
 
-#ifdef __USE_GNU_GETTEXT
-	++_nl_msg_cat_cntr;
-#endif
-
-#ifdef _WIN32
-	SetThreadLocale(MAKELCID(MAKELANGID(WindowsGetLanguage(lang), SUBLANG_DEFAULT), SORT_DEFAULT));
-#else
-	/* First, set LANG and LANGUAGE env variables.
-	 * Some systems (Debian) don't care about this, so we must setlocale LC_ALL as well.
-	 * BUT if this call fails because the LANGUAGE env variable is set, setlocale resets
-	 * the locale to "C", which short circuits gettext and causes it to fail on systems that
-	 * use the LANGUAGE env variable. We must reset the locale to en_US (or, anything not
-	 * C or POSIX) then.
-	 */
-	setenv("LANG", lang, 1);
-	setenv("LANGUAGE", lang, 1);
-	if (setlocale(LC_ALL, lang) == NULL)
-		setlocale(LC_ALL, "en_US");
-#endif
-	const char *translated_string = dgettext("anope", string);
-	for (unsigned i = 0; translated_string == string && i < Domains.size(); ++i)
-		translated_string = dgettext(Domains[i].c_str(), string);
-#ifdef _WIN32
-	SetThreadLocale(MAKELCID(MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT), SORT_DEFAULT));
-#else
-	unsetenv("LANGUAGE");
-	unsetenv("LANG");
-	setlocale(LC_ALL, "");
-#endif
-
-	return translated_string;
-}
-#else
-const char *Language::Translate(const char *lang, const char *string)
-{
-	return string != NULL ? string : "";
+	for (unsigned i = 0; i < LanguageList.size(); ++i)
+	{
+		const LanguageCatalogs *lc = LanguageList[i];
+		if (strcmp(lc->name.c_str(), lang))
+			continue;
+
+		size_t hash = HashMessage(string), mask = lc->index.size() - 1;
+		for (size_t k = hash & mask;; k = (k + 1) & mask)
+		{
+			const CatalogEntry &e = lc->index[k];
+
+			if (e.msgid == NULL)
+				break;
+			else if (e.hash == hash && !strcmp(e.msgid, string))
+				return e.msgstr;
+		}
+		break;
+	}
+
+	return string;
 }
-#endif
@@ -155,7 +155,6 @@ int main(int ac, char **av, char **envp)
 	}
 
 	/* Set up timers */
-	time_t last_check = Anope::CurTime;
 	UpdateTimer updateTimer(Config->GetBlock("options")->Get<time_t>("updatetimeout", "5m"));
 	ExpireTimer expireTimer(Config->GetBlock("options")->Get<time_t>("expiretimeout", "30m"));
 
@@ -165,13 +164,9 @@ int main(int ac, char **av, char **envp)
 		Log(LOG_DEBUG_2) << "Top of main loop";
 
 		/* Process timers */
-		if (Anope::CurTime - last_check >= Config->TimeoutCheck)
-		{
-			TimerManager::TickTimers(Anope::CurTime);
-			last_check = Anope::CurTime;
-		}
+		TimerManager::TickTimers(Anope::CurTime);
 
-		/* Process the socket engine */
+		/* Process the socket engine, this waits until the next timer is due at the latest */
 		SocketEngine::Process();
 
 		if (Anope::Signal)
@@ -34,21 +34,24 @@ Memo::~Memo()
 	}
 }
 
+static const Serialize::Key owner_key("owner"), time_key("time", Serialize::Data::DT_INT), sender_key("sender"), text_key("text"),
+	unread_key("unread"), receipt_key("receipt");
+
 void Memo::Serialize(Serialize::Data &data) const
 {
-	data["owner"] << this->owner;
-	data.SetType("time", Serialize::Data::DT_INT); data["time"] << this->time;
-	data["sender"] << this->sender;
-	data["text"] << this->text;
-	data["unread"] << this->unread;
-	data["receipt"] << this->receipt;
+	data.Set(owner_key, this->owner);
+	data.Set(time_key, this->time);
+	data.Set(sender_key, this->sender);
+	data.Set(text_key, this->text);
+	data.Set(unread_key, this->unread);
+	data.Set(receipt_key, this->receipt);
 }
 
 Serializable* Memo::Unserialize(Serializable *obj, Serialize::Data &data)
 {
 	Anope::string owner;
 
-	data["owner"] >> owner;
+	data.Get(owner_key, owner);
 
 	bool ischan;
 	MemoInfo *mi = MemoInfo::GetMemoInfo(owner, ischan);
@@ -65,11 +68,11 @@ Serializable* Memo::Unserialize(Serializable *obj, Serialize::Data &data)
 	}
 
 	m->owner = owner;
-	data["time"] >> m->time;
-	data["sender"] >> m->sender;
-	data["text"] >> m->text;
-	data["unread"] >> m->unread;
-	data["receipt"] >> m->receipt;
+	data.Get(time_key, m->time);
+	data.Get(sender_key, m->sender);
+	data.Get(text_key, m->text);
+	data.Get(unread_key, m->unread);
+	data.Get(receipt_key, m->receipt);
 
 	if (obj == NULL)
 		mi->memos->push_back(m);
@@ -133,7 +136,11 @@ MemoInfo *MemoInfo::GetMemoInfo(const Anope::string &target, bool &ischan)
 		ischan = false;
 		NickAlias *na = NickAlias::Find(target);
 		if (na != NULL)
+		{
+			/* The memo info is serialized with the account, which the caller may change, as ChannelInfo::Find does for channels */
+			na->nc->QueueUpdate();
 			return &na->nc->memos;
+		}
 	}
 
 	return NULL;
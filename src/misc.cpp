@@ -403,108 +403,238 @@ Anope::string Anope::Expires(time_t expires, const NickCore *nc)
 	}
 }
 
-bool Anope::Match(const Anope::string &str, const Anope::string &mask, bool case_sensitive, bool use_regex)
+Anope::Matcher::Matcher(const Anope::string &m, bool cs) : mask(m), case_sensitive(cs), min_length(0)
+{
+	size_t start = 0;
+	for (size_t pos; (pos = this->mask.find('*', start)) != Anope::string::npos; start = pos + 1)
+	{
+		this->segments.push_back(std::make_pair(start, pos - start));
+		this->min_length += pos - start;
+	}
+	this->segments.push_back(std::make_pair(start, this->mask.length() - start));
+	this->min_length += this->mask.length() - start;
+}
+
+bool Anope::Matcher::MatchSegment(const char *str, const std::pair<size_t, size_t> &segment) const
+{
+	const char *wild = this->mask.c_str() + segment.first;
+
+	if (this->case_sensitive)
+	{
+		for (size_t i = 0; i < segment.second; ++i)
+			if (wild[i] != str[i] && wild[i] != '?')
+				return false;
+	}
+	else
+	{
+		for (size_t i = 0; i < segment.second; ++i)
+			if (Anope::tolower(wild[i]) != Anope::tolower(str[i]) && wild[i] != '?')
+				return false;
+	}
+
+	return true;
+}
+
+bool Anope::Matcher::Matches(const Anope::string &str) const
 {
-	size_t s = 0, m = 0, str_len = str.length(), mask_len = mask.length();
+	const char *s = str.c_str();
+	size_t str_len = str.length();
+
+	if (str_len < this->min_length)
+		return false;
 
-	if (use_regex && mask_len >= 2 && mask[0] == '/' && mask[mask.length() - 1] == '/')
+	const std::pair<size_t, size_t> &first = this->segments.front();
+	if (this->segments.size() == 1)
+		return str_len == first.second && this->MatchSegment(s, first);
+
+	/* The text before the first * and after the last * must be at each end of the string */
+	const std::pair<size_t, size_t> &last = this->segments.back();
+	if (!this->MatchSegment(s, first) || !this->MatchSegment(s + str_len - last.second, last))
+		return false;
+
+	/* Everything in between can be matched as early as possible, as the *s can take up whatever is left over,
+	 * so this never has to backtrack.
+	 */
+	size_t pos = first.second, end = str_len - last.second;
+	for (unsigned i = 1; i + 1 < this->segments.size(); ++i)
 	{
-		Anope::string stripped_mask = mask.substr(1, mask_len - 2);
-		// This is often called with the same mask multiple times in a row, so cache it
-		static Regex *r = NULL;
+		const std::pair<size_t, size_t> &segment = this->segments[i];
 
-		if (r == NULL || r->GetExpression() != stripped_mask)
+		for (;; ++pos)
 		{
-			ServiceReference<RegexProvider> provider("Regex", Config->GetBlock("options")->Get<const Anope::string>("regexengine"));
-			if (provider)
-			{
-				try
-				{
-					delete r;
-					r = NULL;
-					// This may throw
-					r = provider->Compile(stripped_mask);
-				}
-				catch (const RegexException &ex)
-				{
-					Log(LOG_DEBUG) << ex.GetReason();
-				}
-			}
-			else
-			{
-				delete r;
-				r = NULL;
-			}
+			if (end - pos < segment.second)
+				return false;
+			if (this->MatchSegment(s + pos, segment))
+				break;
 		}
 
-		if (r != NULL && r->Matches(str))
-			return true;
+		pos += segment.second;
+	}
 
-		// Fall through to non regex match
+	return true;
+}
+
+/* Regexes given to Match() are compiled and kept here, least recently used first */
+static const unsigned RegexCacheSize = 1024;
+
+struct RegexCacheEntry
+{
+	Regex *regex;
+	/* Regexes are only deleted while their provider still exists, as their code is in its module */
+	Reference<RegexProvider> provider;
+
+	RegexCacheEntry() : regex(NULL) { }
+
+	void Clear()
+	{
+		if (this->provider)
+			delete this->regex;
+		this->regex = NULL;
 	}
+};
+
+class RegexCache
+{
+	typedef std::list<std::pair<Anope::string, RegexCacheEntry> > list_type;
+	list_type entries;
+	TR1NS::unordered_map<Anope::string, list_type::iterator, Anope::hash_cs> index;
 
-	while (s < str_len && m < mask_len && mask[m] != '*')
+ public:
+	/** Find a cached regex, or create an empty entry for it if it isn't cached
+	 * @param mask The mask
+	 * @param created Set to true if the entry was created
+	 */
+	RegexCacheEntry &Get(const Anope::string &mask, bool &created)
 	{
-		char string = str[s], wild = mask[m];
-		if (case_sensitive)
+		TR1NS::unordered_map<Anope::string, list_type::iterator, Anope::hash_cs>::iterator it = this->index.find(mask);
+		if (it != this->index.end())
 		{
-			if (wild != string && wild != '?')
-				return false;
+			created = false;
+			this->entries.splice(this->entries.end(), this->entries, it->second);
+			return it->second->second;
 		}
-		else
+
+		if (this->entries.size() >= RegexCacheSize)
 		{
-			if (Anope::tolower(wild) != Anope::tolower(string) && wild != '?')
-				return false;
+			this->entries.front().second.Clear();
+			this->index.erase(this->entries.front().first);
+			this->entries.pop_front();
 		}
 
-		++m;
-		++s;
+		created = true;
+		this->entries.push_back(std::make_pair(mask, RegexCacheEntry()));
+		list_type::iterator last = this->entries.end();
+		--last;
+		this->index[mask] = last;
+		return last->second;
+	}
+};
+
+static RegexCache Regexes;
+
+static inline bool MatchChar(char wild, char c, bool case_sensitive)
+{
+	if (wild == '?')
+		return true;
+	return case_sensitive ? wild == c : Anope::tolower(wild) == Anope::tolower(c);
+}
+
+/* Matches a mask the same way Anope::Matcher does, but without compiling it first */
+static bool MatchMask(const Anope::string &str, const Anope::string &mask, bool case_sensitive)
+{
+	const char *s = str.c_str(), *m = mask.c_str();
+	size_t str_len = str.length(), mask_len = mask.length();
+
+	size_t first_star = mask.find('*');
+	if (first_star == Anope::string::npos)
+	{
+		if (str_len != mask_len)
+			return false;
+		for (size_t i = 0; i < mask_len; ++i)
+			if (!MatchChar(m[i], s[i], case_sensitive))
+				return false;
+		return true;
 	}
 
-	size_t sp = Anope::string::npos, mp = Anope::string::npos;
-	while (s < str_len)
+	/* The text before the first * and after the last * must be at each end of the string */
+	size_t last_star = mask.rfind('*'), last_len = mask_len - last_star - 1;
+	if (str_len < first_star + last_len)
+		return false;
+
+	for (size_t i = 0; i < first_star; ++i)
+		if (!MatchChar(m[i], s[i], case_sensitive))
+			return false;
+	for (size_t i = 0; i < last_len; ++i)
+		if (!MatchChar(m[last_star + 1 + i], s[str_len - last_len + i], case_sensitive))
+			return false;
+
+	/* The pieces in between are matched as early as possible */
+	size_t pos = first_star, end = str_len - last_len;
+	for (size_t seg = first_star + 1, next; seg < last_star; seg = next + 1)
 	{
-		char string = str[s], wild = mask[m];
-		if (wild == '*')
+		next = mask.find('*', seg);
+		size_t seg_len = next - seg;
+
+		for (;; ++pos)
 		{
-			if (++m == mask_len)
-				return 1;
+			if (end - pos < seg_len)
+				return false;
 
-			mp = m;
-			sp = s + 1;
+			size_t i = 0;
+			while (i < seg_len && MatchChar(m[seg + i], s[pos + i], case_sensitive))
+				++i;
+			if (i == seg_len)
+				break;
 		}
-		else if (case_sensitive)
+
+		pos += seg_len;
+	}
+
+	return true;
+}
+
+bool Anope::Match(const Anope::string &str, const Anope::string &mask, bool case_sensitive, bool use_regex)
+{
+	size_t mask_len = mask.length();
+
+	if (use_regex && mask_len >= 2 && mask[0] == '/' && mask[mask_len - 1] == '/')
+	{
+		const Anope::string &engine = Config->GetBlock("options")->Get<const Anope::string>("regexengine");
+		bool created;
+		RegexCacheEntry &entry = Regexes.Get(mask, created);
+
+		/* Compile it again if the regex engine has been changed or unloaded */
+		if (!created && (!entry.provider || entry.provider->name != engine))
 		{
-			if (wild == string || wild == '?')
-			{
-				++m;
-				++s;
-			}
-			else
-			{
-				m = mp;
-				s = sp++;
-			}
+			entry.Clear();
+			created = true;
 		}
-		else
+
+		if (created)
 		{
-			if (Anope::tolower(wild) == Anope::tolower(string) || wild == '?')
-			{
-				++m;
-				++s;
-			}
-			else
+			ServiceReference<RegexProvider> provider("Regex", engine);
+			if (provider)
 			{
-				m = mp;
-				s = sp++;
+				try
+				{
+					entry.provider = *provider;
+					// This may throw
+					entry.regex = provider->Compile(mask.substr(1, mask_len - 2));
+				}
+				catch (const RegexException &ex)
+				{
+					Log(LOG_DEBUG) << ex.GetReason();
+				}
 			}
 		}
-	}
 
-	if (m < mask_len && mask[m] == '*')
-		++m;
+		if (entry.regex != NULL && entry.provider && entry.regex->Matches(str))
+			return true;
+
+		// Fall through to non regex match
+	}
 
-	return m == mask_len;
+	return MatchMask(str, mask, case_sensitive);
 }
 
 void Anope::Encrypt(const Anope::string &src, Anope::string &dest)
@@ -11,10 +11,6 @@
 #include "language.h"
 #include "account.h"
 
-#ifdef GETTEXT_FOUND
-# include <libintl.h>
-#endif
-
 Module::Module(const Anope::string &modname, const Anope::string &, ModType modtype) : name(modname), type(modtype)
 {
 	this->handle = NULL;
@@ -39,26 +35,7 @@ Module::Module(const Anope::string &modname, const Anope::string &, ModType modt
 
 	ModuleManager::Modules.push_back(this);
 
-#if GETTEXT_FOUND
-	for (unsigned i = 0; i < Language::Languages.size(); ++i)
-	{
-		/* Remove .UTF-8 or any other suffix */
-		Anope::string lang;
-		sepstream(Language::Languages[i], '.').GetToken(lang);
-
-		if (Anope::IsFile(Anope::LocaleDir + "/" + lang + "/LC_MESSAGES/" + modname + ".mo"))
-		{
-			if (!bindtextdomain(this->name.c_str(), Anope::LocaleDir.c_str()))
-				Log() << "Error calling bindtextdomain, " << Anope::LastError();
-			else
-			{
-				Log() << "Found language file " << lang << " for " << modname;
-				Language::Domains.push_back(modname);
-			}
-			break;
-		}
-	}
-#endif
+	Language::AddDomain(modname);
 }
 
 Module::~Module()
@@ -75,11 +52,7 @@ Module::~Module()
 	if (it != ModuleManager::Modules.end())
 		ModuleManager::Modules.erase(it);
 
-#if GETTEXT_FOUND
-	std::vector<Anope::string>::iterator dit = std::find(Language::Domains.begin(), Language::Domains.end(), this->name);
-	if (dit != Language::Domains.end())
-		Language::Domains.erase(dit);
-#endif
+	Language::RemoveDomain(this->name);
 }
 
 void Module::SetPermanent(bool state)
@@ -17,6 +17,7 @@
 #include "users.h"
 #include "servers.h"
 #include "config.h"
+#include "regchannel.h"
 
 Serialize::Checker<nickalias_map> NickAliasList("NickAlias");
 
@@ -46,6 +47,9 @@ NickAlias::NickAlias(const Anope::string &nickname, NickCore* nickcore) : Serial
 		if (this->nc->o != NULL)
 			Log() << "Tied oper " << this->nc->display << " to type " << this->nc->o->ot->GetName();
 	}
+
+	/* Access entries for this nick now match the account */
+	ChannelInfo::ClearAccessCache();
 }
 
 NickAlias::~NickAlias()
@@ -54,6 +58,8 @@ NickAlias::~NickAlias()
 
 	UnsetExtensibles();
 
+	ChannelInfo::ClearAccessCache();
+
 	/* Accept nicks that have no core, because of database load functions */
 	if (this->nc)
 	{
@@ -131,23 +137,27 @@ NickAlias *NickAlias::Find(const Anope::string &nick)
 	return NULL;
 }
 
+static const Serialize::Key nick_key("nick"), last_quit_key("last_quit"), last_realname_key("last_realname"), last_usermask_key("last_usermask"),
+	last_realhost_key("last_realhost"), time_registered_key("time_registered", Serialize::Data::DT_INT), last_seen_key("last_seen", Serialize::Data::DT_INT),
+	nc_key("nc"), vhost_ident_key("vhost_ident"), vhost_host_key("vhost_host"), vhost_creator_key("vhost_creator"), vhost_time_key("vhost_time");
+
 void NickAlias::Serialize(Serialize::Data &data) const
 {
-	data["nick"] << this->nick;
-	data["last_quit"] << this->last_quit;
-	data["last_realname"] << this->last_realname;
-	data["last_usermask"] << this->last_usermask;
-	data["last_realhost"] << this->last_realhost;
-	data.SetType("time_registered", Serialize::Data::DT_INT); data["time_registered"] << this->time_registered;
-	data.SetType("last_seen", Serialize::Data::DT_INT); data["last_seen"] << this->last_seen;
-	data["nc"] << this->nc->display;
+	data.Set(nick_key, this->nick);
+	data.Set(last_quit_key, this->last_quit);
+	data.Set(last_realname_key, this->last_realname);
+	data.Set(last_usermask_key, this->last_usermask);
+	data.Set(last_realhost_key, this->last_realhost);
+	data.Set(time_registered_key, this->time_registered);
+	data.Set(last_seen_key, this->last_seen);
+	data.Set(nc_key, this->nc->display);
 
 	if (this->HasVhost())
 	{
-		data["vhost_ident"] << this->GetVhostIdent();
-		data["vhost_host"] << this->GetVhostHost();
-		data["vhost_creator"] << this->GetVhostCreator();
-		data["vhost_time"] << this->GetVhostCreated();
+		data.Set(vhost_ident_key, this->GetVhostIdent());
+		data.Set(vhost_host_key, this->GetVhostHost());
+		data.Set(vhost_creator_key, this->GetVhostCreator());
+		data.Set(vhost_time_key, this->GetVhostCreated());
 	}
 
 	Extensible::ExtensibleSerialize(this, this, data);
@@ -157,8 +167,8 @@ Serializable* NickAlias::Unserialize(Serializable *obj, Serialize::Data &data)
 {
 	Anope::string snc, snick;
 
-	data["nc"] >> snc;
-	data["nick"] >> snick;
+	data.Get(nc_key, snc);
+	data.Get(nick_key, snick);
 
 	NickCore *core = NickCore::Find(snc);
 	if (core == NULL)
@@ -183,22 +193,24 @@ Serializable* NickAlias::Unserialize(Serializable *obj, Serialize::Data &data)
 
 		na->nc = core;
 		core->aliases->push_back(na);
+
+		ChannelInfo::ClearAccessCache();
 	}
 
-	data["last_quit"] >> na->last_quit;
-	data["last_realname"] >> na->last_realname;
-	data["last_usermask"] >> na->last_usermask;
-	data["last_realhost"] >> na->last_realhost;
-	data["time_registered"] >> na->time_registered;
-	data["last_seen"] >> na->last_seen;
+	data.Get(last_quit_key, na->last_quit);
+	data.Get(last_realname_key, na->last_realname);
+	data.Get(last_usermask_key, na->last_usermask);
+	data.Get(last_realhost_key, na->last_realhost);
+	data.Get(time_registered_key, na->time_registered);
+	data.Get(last_seen_key, na->last_seen);
 
 	Anope::string vhost_ident, vhost_host, vhost_creator;
 	time_t vhost_time;
 
-	data["vhost_ident"] >> vhost_ident;
-	data["vhost_host"] >> vhost_host;
-	data["vhost_creator"] >> vhost_creator;
-	data["vhost_time"] >> vhost_time;
+	data.Get(vhost_ident_key, vhost_ident);
+	data.Get(vhost_host_key, vhost_host);
+	data.Get(vhost_creator_key, vhost_creator);
+	data.Get(vhost_time_key, vhost_time);
 
 	na->SetVhost(vhost_ident, vhost_host, vhost_creator, vhost_time);
 
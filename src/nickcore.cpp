@@ -13,6 +13,7 @@
 #include "modules.h"
 #include "account.h"
 #include "config.h"
+#include "regchannel.h"
 
 Serialize::Checker<nickcore_map> NickCoreList("NickCore");
 
@@ -53,6 +54,8 @@ NickCore::~NickCore()
 
 	NickCoreList->erase(this->display);
 
+	ChannelInfo::ClearAccessCache();
+
 	this->ClearAccess();
 
 	if (!this->memos.memos->empty())
@@ -63,17 +66,30 @@ NickCore::~NickCore()
 	}
 }
 
+static const Serialize::Key display_key("display"), pass_key("pass"), email_key("email"), language_key("language"), access_key("access"),
+	memomax_key("memomax"), memoignores_key("memoignores");
+
 void NickCore::Serialize(Serialize::Data &data) const
 {
-	data["display"] << this->display;
-	data["pass"] << this->pass;
-	data["email"] << this->email;
-	data["language"] << this->language;
-	for (unsigned i = 0; i < this->access.size(); ++i)
-		data["access"] << this->access[i] << " ";
-	data["memomax"] << this->memos.memomax;
-	for (unsigned i = 0; i < this->memos.ignores.size(); ++i)
-		data["memoignores"] << this->memos.ignores[i] << " ";
+	data.Set(display_key, this->display);
+	data.Set(pass_key, this->pass);
+	data.Set(email_key, this->email);
+	data.Set(language_key, this->language);
+	if (!this->access.empty())
+	{
+		Anope::string buf;
+		for (unsigned i = 0; i < this->access.size(); ++i)
+			buf += this->access[i] + " ";
+		data.Set(access_key, buf);
+	}
+	data.Set(memomax_key, this->memos.memomax);
+	if (!this->memos.ignores.empty())
+	{
+		Anope::string buf;
+		for (unsigned i = 0; i < this->memos.ignores.size(); ++i)
+			buf += this->memos.ignores[i] + " ";
+		data.Set(memoignores_key, buf);
+	}
 	Extensible::ExtensibleSerialize(this, this, data);
 }
 
@@ -83,28 +99,38 @@ Serializable* NickCore::Unserialize(Serializable *obj, Serialize::Data &data)
 
 	Anope::string sdisplay;
 
-	data["display"] >> sdisplay;
+	data.Get(display_key, sdisplay);
 
 	if (obj)
+	{
 		nc = anope_dynamic_static_cast<NickCore *>(obj);
+
+		/* The display may have been changed since this core was last loaded */
+		if (!sdisplay.empty() && nc->display != sdisplay)
+		{
+			NickCoreList->erase(nc->display);
+			nc->display = sdisplay;
+			(*NickCoreList)[nc->display] = nc;
+		}
+	}
 	else
 		nc = new NickCore(sdisplay);
 
-	data["pass"] >> nc->pass;
-	data["email"] >> nc->email;
-	data["language"] >> nc->language;
+	data.Get(pass_key, nc->pass);
+	data.Get(email_key, nc->email);
+	data.Get(language_key, nc->language);
 	{
 		Anope::string buf;
-		data["access"] >> buf;
+		data.Get(access_key, buf);
 		spacesepstream sep(buf);
 		nc->access.clear();
 		while (sep.GetToken(buf))
 			nc->access.push_back(buf);
 	}
-	data["memomax"] >> nc->memos.memomax;
+	data.Get(memomax_key, nc->memos.memomax);
 	{
 		Anope::string buf;
-		data["memoignores"] >> buf;
+		data.Get(memoignores_key, buf);
 		spacesepstream sep(buf);
 		nc->memos.ignores.clear();
 		while (sep.GetToken(buf))
@@ -159,6 +185,8 @@ void NickCore::SetDisplay(const NickAlias *na)
 
 	FOREACH_MOD(OnChangeCoreDisplay, (this, na->nick));
 
+	this->QueueUpdate();
+
 	/* this affects the serialized aliases */
 	for (unsigned i = 0; i < aliases->size(); ++i)
 		aliases->at(i)->QueueUpdate();
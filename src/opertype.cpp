@@ -51,62 +51,165 @@ OperType *OperType::Find(const Anope::string &name)
 	return NULL;
 }
 
-OperType::OperType(const Anope::string &nname) : name(nname)
-{
-}
+/* Incremented whenever any opertype changes, as that can change what opertypes inheriting it have */
+static unsigned rules_generation = 0;
 
-bool OperType::HasCommand(const Anope::string &cmdstr) const
+struct OperType::Rules
 {
-	for (std::list<Anope::string>::const_iterator it = this->commands.begin(), it_end = this->commands.end(); it != it_end; ++it)
+	struct Rule
+	{
+		Anope::Matcher mask;
+		/* Position of the rule, earlier rules take precedence */
+		unsigned pos;
+		bool negated;
+
+		Rule(const Anope::string &m, unsigned p, bool n) : mask(m), pos(p), negated(n) { }
+	};
+
+	/* The first rule for each mask without wildcards, as the position and whether it is negated */
+	Anope::hash_map<std::pair<unsigned, bool> > exact;
+	/* The rules with wildcards, in order */
+	std::vector<Rule> wildcards;
+	/* The result of checking strings, including against inherited opertypes */
+	Anope::hash_map<bool> results;
+	unsigned generation;
+
+	Rules(const std::list<Anope::string> &list) : generation(rules_generation)
+	{
+		unsigned pos = 0;
+		for (std::list<Anope::string>::const_iterator it = list.begin(), it_end = list.end(); it != it_end; ++it)
+		{
+			const Anope::string &s = *it;
+
+			/* A ~mask which does not match may still match literally */
+			if (!s.find('~'))
+				this->Add(s.substr(1), pos++, true);
+			this->Add(s, pos++, false);
+		}
+	}
+
+	void Add(const Anope::string &mask, unsigned pos, bool negated)
+	{
+		if (mask.find_first_of("*?") != Anope::string::npos)
+			this->wildcards.push_back(Rule(mask, pos, negated));
+		else if (!this->exact.count(mask))
+			this->exact[mask] = std::make_pair(pos, negated);
+	}
+
+	/* Returns 1 if the first rule matching str allows it, 0 if it denies it, or -1 if no rule matches */
+	int Check(const Anope::string &str) const
 	{
-		const Anope::string &s = *it;
+		unsigned exact_pos = static_cast<unsigned>(-1);
+		bool exact_negated = false;
+
+		Anope::hash_map<std::pair<unsigned, bool> >::const_iterator it = this->exact.find(str);
+		if (it != this->exact.end())
+		{
+			exact_pos = it->second.first;
+			exact_negated = it->second.second;
+		}
+
+		for (unsigned i = 0; i < this->wildcards.size() && this->wildcards[i].pos < exact_pos; ++i)
+			if (this->wildcards[i].mask.Matches(str))
+				return !this->wildcards[i].negated;
 
-		if (!s.find('~') && Anope::Match(cmdstr, s.substr(1)))
-			return false;
-		else if (Anope::Match(cmdstr, s))
-			return true;
+		if (it != this->exact.end())
+			return !exact_negated;
+
+		return -1;
 	}
-	for (std::set<OperType *>::const_iterator iit = this->inheritances.begin(), iit_end = this->inheritances.end(); iit != iit_end; ++iit)
+
+	static Rules *Get(Rules *&rules, const std::list<Anope::string> &list)
 	{
-		OperType *ot = *iit;
+		if (rules && rules->generation != rules_generation)
+		{
+			delete rules;
+			rules = NULL;
+		}
+
+		if (!rules)
+			rules = new Rules(list);
+
+		return rules;
+	}
+};
+
+OperType::OperType(const Anope::string &nname) : name(nname), priv_rules(NULL), command_rules(NULL)
+{
+}
+
+OperType::~OperType()
+{
+	delete this->priv_rules;
+	delete this->command_rules;
+}
+
+bool OperType::HasCommand(const Anope::string &cmdstr) const
+{
+	Rules *rules = Rules::Get(this->command_rules, this->commands);
 
-		if (ot->HasCommand(cmdstr))
-			return true;
+	Anope::hash_map<bool>::const_iterator it = rules->results.find(cmdstr);
+	if (it != rules->results.end())
+		return it->second;
+
+	int result = rules->Check(cmdstr);
+	if (result < 0)
+	{
+		result = 0;
+		for (std::set<OperType *>::const_iterator iit = this->inheritances.begin(), iit_end = this->inheritances.end(); iit != iit_end; ++iit)
+		{
+			OperType *ot = *iit;
+
+			if (ot->HasCommand(cmdstr))
+			{
+				result = 1;
+				break;
+			}
+		}
 	}
 
-	return false;
+	rules->results[cmdstr] = result;
+	return result;
 }
 
 bool OperType::HasPriv(const Anope::string &privstr) const
 {
-	for (std::list<Anope::string>::const_iterator it = this->privs.begin(), it_end = this->privs.end(); it != it_end; ++it)
-	{
-		const Anope::string &s = *it;
+	Rules *rules = Rules::Get(this->priv_rules, this->privs);
 
-		if (!s.find('~') && Anope::Match(privstr, s.substr(1)))
-			return false;
-		else if (Anope::Match(privstr, s))
-			return true;
-	}
-	for (std::set<OperType *>::const_iterator iit = this->inheritances.begin(), iit_end = this->inheritances.end(); iit != iit_end; ++iit)
-	{
-		OperType *ot = *iit;
+	Anope::hash_map<bool>::const_iterator it = rules->results.find(privstr);
+	if (it != rules->results.end())
+		return it->second;
 
-		if (ot->HasPriv(privstr))
-			return true;
+	int result = rules->Check(privstr);
+	if (result < 0)
+	{
+		result = 0;
+		for (std::set<OperType *>::const_iterator iit = this->inheritances.begin(), iit_end = this->inheritances.end(); iit != iit_end; ++iit)
+		{
+			OperType *ot = *iit;
+
+			if (ot->HasPriv(privstr))
+			{
+				result = 1;
+				break;
+			}
+		}
 	}
 
-	return false;
+	rules->results[privstr] = result;
+	return result;
 }
 
 void OperType::AddCommand(const Anope::string &cmdstr)
 {
 	this->commands.push_back(cmdstr);
+	++rules_generation;
 }
 
 void OperType::AddPriv(const Anope::string &privstr)
 {
 	this->privs.push_back(privstr);
+	++rules_generation;
 }
 
 const Anope::string &OperType::GetName() const
@@ -118,6 +221,7 @@ void OperType::Inherits(OperType *ot)
 {
 	if (ot != this)
 		this->inheritances.insert(ot);
+	++rules_generation;
 }
 
 const std::list<Anope::string> OperType::GetCommands() const
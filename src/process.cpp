@@ -24,21 +24,21 @@ void Anope::Process(const Anope::string &buffer)
 	if (buffer.empty())
 		return;
 
-	Anope::string source, command;
-	std::vector<Anope::string> params;
+	MessageTokens tokens;
+	IRCD->Parse(buffer, tokens);
 
-	IRCD->Parse(buffer, source, command, params);
+	Anope::string source = tokens.source.str(), command = tokens.command.str();
 
 	if (Anope::ProtocolDebug)
 	{
 		Log() << "Source : " << (source.empty() ? "No source" : source);
 		Log() << "Command: " << command;
 
-		if (params.empty())
+		if (tokens.empty())
 			Log() << "No params";
 		else
-			for (unsigned i = 0; i < params.size(); ++i)
-				Log() << "params " << i << ": " << params[i];
+			for (unsigned i = 0; i < tokens.size(); ++i)
+				Log() << "params " << i << ": " << tokens[i].str();
 	}
 
 	if (command.empty())
@@ -47,56 +47,132 @@ void Anope::Process(const Anope::string &buffer)
 		return;
 	}
 
-	static const Anope::string proto_name = ModuleManager::FindFirstOf(PROTOCOL) ? ModuleManager::FindFirstOf(PROTOCOL)->name : "";
-
 	MessageSource src(source);
 
-	EventReturn MOD_RESULT;
-	FOREACH_RESULT(OnMessage, MOD_RESULT, (src, command, params));
-	if (MOD_RESULT == EVENT_STOP)
-		return;
+	/* Only copy the parameters out if a module wants to see (and possibly change) them */
+	std::vector<Anope::string> params;
+	if (!ModuleManager::EventHandlers[I_OnMessage].empty())
+	{
+		tokens.GetParams(params);
 
-	ServiceReference<IRCDMessage> m("IRCDMessage", proto_name + "/" + command.lower());
+		EventReturn MOD_RESULT;
+		FOREACH_RESULT(OnMessage, MOD_RESULT, (src, command, params));
+		if (MOD_RESULT == EVENT_STOP)
+			return;
+
+		tokens = MessageTokens(params);
+	}
+
+	IRCDMessage *m = IRCDMessage::Find(command);
 	if (!m)
 	{
 		Log(LOG_DEBUG) << "unknown message from server (" << buffer << ")";
 		return;
 	}
 
-	if (m->HasFlag(IRCDMESSAGE_SOFT_LIMIT) ? (params.size() < m->GetParamCount()) : (params.size() != m->GetParamCount()))
-		Log(LOG_DEBUG) << "invalid parameters for " << command << ": " << params.size() << " != " << m->GetParamCount();
+	if (m->HasFlag(IRCDMESSAGE_SOFT_LIMIT) ? (tokens.size() < m->GetParamCount()) : (tokens.size() != m->GetParamCount()))
+		Log(LOG_DEBUG) << "invalid parameters for " << command << ": " << tokens.size() << " != " << m->GetParamCount();
 	else if (m->HasFlag(IRCDMESSAGE_REQUIRE_USER) && !src.GetUser())
 		Log(LOG_DEBUG) << "unexpected non-user source " << source << " for " << command;
 	else if (m->HasFlag(IRCDMESSAGE_REQUIRE_SERVER) && !source.empty() && !src.GetServer())
 		Log(LOG_DEBUG) << "unexpected non-server source " << source << " for " << command;
 	else
-		m->Run(src, params);
+		m->Run(src, tokens);
+}
+
+bool MessageTokens::Token::equals_cs(const char *s) const
+{
+	return !strncmp(this->data, s, this->length) && !s[this->length];
+}
+
+bool MessageTokens::Token::GetToken(size_t &pos, Token &word) const
+{
+	while (pos < this->length && this->data[pos] == ' ')
+		++pos;
+	if (pos >= this->length)
+		return false;
+
+	size_t start = pos;
+	while (pos < this->length && this->data[pos] != ' ')
+		++pos;
+
+	word = Token(this->data + start, pos - start);
+	return true;
+}
+
+MessageTokens::MessageTokens() : count(0)
+{
+}
+
+MessageTokens::MessageTokens(const std::vector<Anope::string> &params) : count(0)
+{
+	for (unsigned i = 0; i < params.size(); ++i)
+		this->Push(params[i].c_str(), params[i].length());
+}
+
+void MessageTokens::Push(const char *data, size_t length)
+{
+	if (this->count < InlineParams)
+		this->inline_params[this->count] = Token(data, length);
+	else
+		this->extra_params.push_back(Token(data, length));
+	++this->count;
+}
+
+Anope::string MessageTokens::Join(unsigned first, unsigned last) const
+{
+	Anope::string joined;
+	for (unsigned i = first; i < last && i < this->count; ++i)
+	{
+		if (i != first)
+			joined += ' ';
+		joined.str().append((*this)[i].data, (*this)[i].length);
+	}
+	return joined;
+}
+
+void MessageTokens::GetParams(std::vector<Anope::string> &params) const
+{
+	params.reserve(params.size() + this->count);
+	for (unsigned i = 0; i < this->count; ++i)
+		params.push_back((*this)[i].str());
+}
+
+IRCDProto::ObsoleteParse IRCDProto::Parse(const Anope::string &buffer, Anope::string &source, Anope::string &command, std::vector<Anope::string> &params)
+{
+	MessageTokens tokens;
+	this->Parse(buffer, tokens);
+
+	source = tokens.source.str();
+	command = tokens.command.str();
+	tokens.GetParams(params);
+	return ObsoleteParse();
 }
 
-void IRCDProto::Parse(const Anope::string &buffer, Anope::string &source, Anope::string &command, std::vector<Anope::string> &params)
+void IRCDProto::Parse(const Anope::string &buffer, MessageTokens &tokens)
 {
-	spacesepstream sep(buffer);
+	MessageTokens::Token line(buffer.c_str(), buffer.length());
+	size_t pos = 0;
 
 	if (buffer[0] == ':')
 	{
-		sep.GetToken(source);
-		source.erase(0, 1);
+		line.GetToken(pos, tokens.source);
+		++tokens.source.data;
+		--tokens.source.length;
 	}
 
-	sep.GetToken(command);
+	line.GetToken(pos, tokens.command);
 
-	for (Anope::string token; sep.GetToken(token);)
+	for (MessageTokens::Token token; line.GetToken(pos, token);)
 	{
 		if (token[0] == ':')
 		{
-			if (!sep.StreamEnd())
-				params.push_back(token.substr(1) + " " + sep.GetRemaining());
-			else
-				params.push_back(token.substr(1));
+			/* The last parameter is everything after the colon */
+			tokens.Push(token.data + 1, line.data + line.length - token.data - 1);
 			break;
 		}
 		else
-			params.push_back(token);
+			tokens.Push(token.data, token.length);
 	}
 }
 
@@ -498,7 +498,39 @@ IRCDMessage::IRCDMessage(Module *o, const Anope::string &n, unsigned p) : Servic
 {
 }
 
+void IRCDMessage::Run(MessageSource &source, const MessageTokens &tokens)
+{
+	std::vector<Anope::string> params;
+	tokens.GetParams(params);
+	this->Run(source, params);
+}
+
 unsigned IRCDMessage::GetParamCount() const
 {
 	return this->param_count;
 }
+
+IRCDMessage *IRCDMessage::Find(const Anope::string &command)
+{
+	static Anope::hash_map<IRCDMessage *> dispatch;
+	static unsigned generation = 0;
+	static Anope::string proto_name;
+
+	if (proto_name.empty() || generation != Service::GetGeneration())
+	{
+		dispatch.clear();
+		generation = Service::GetGeneration();
+		Module *proto = ModuleManager::FindFirstOf(PROTOCOL);
+		proto_name = proto ? proto->name : "";
+	}
+
+	Anope::hash_map<IRCDMessage *>::const_iterator it = dispatch.find(command);
+	if (it != dispatch.end())
+		return it->second;
+
+	IRCDMessage *m = static_cast<IRCDMessage *>(Service::FindService("IRCDMessage", proto_name + "/" + command.lower()));
+	/* Unknown commands are not cached, so the table can't be grown without bound by the uplink */
+	if (m != NULL)
+		dispatch[command] = m;
+	return m;
+}
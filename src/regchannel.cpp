@@ -18,6 +18,7 @@
 #include "config.h"
 #include "bots.h"
 #include "servers.h"
+#include "protocol.h"
 
 Serialize::Checker<registered_channel_map> RegisteredChannelList("ChannelInfo");
 
@@ -38,25 +39,28 @@ AutoKick::~AutoKick()
 	}
 }
 
+static const Serialize::Key ci_key("ci"), nc_key("nc"), mask_key("mask"), reason_key("reason"), creator_key("creator"),
+	addtime_key("addtime", Serialize::Data::DT_INT), last_used_key("last_used", Serialize::Data::DT_INT);
+
 void AutoKick::Serialize(Serialize::Data &data) const
 {
-	data["ci"] << this->ci->name;
+	data.Set(ci_key, this->ci->name);
 	if (this->nc)
-		data["nc"] << this->nc->display;
+		data.Set(nc_key, this->nc->display);
 	else
-		data["mask"] << this->mask;
-	data["reason"] << this->reason;
-	data["creator"] << this->creator;
-	data.SetType("addtime", Serialize::Data::DT_INT); data["addtime"] << this->addtime;
-	data.SetType("last_used", Serialize::Data::DT_INT); data["last_used"] << this->last_used;
+		data.Set(mask_key, this->mask);
+	data.Set(reason_key, this->reason);
+	data.Set(creator_key, this->creator);
+	data.Set(addtime_key, this->addtime);
+	data.Set(last_used_key, this->last_used);
 }
 
 Serializable* AutoKick::Unserialize(Serializable *obj, Serialize::Data &data)
 {
 	Anope::string sci, snc;
 
-	data["ci"] >> sci;
-	data["nc"] >> snc;
+	data.Get(ci_key, sci);
+	data.Get(nc_key, snc);
 
 	ChannelInfo *ci = ChannelInfo::Find(sci);
 	if (!ci)
@@ -67,24 +71,24 @@ Serializable* AutoKick::Unserialize(Serializable *obj, Serialize::Data &data)
 	if (obj)
 	{
 		ak = anope_dynamic_static_cast<AutoKick *>(obj);
-		data["creator"] >> ak->creator;
-		data["reason"] >> ak->reason;
+		data.Get(creator_key, ak->creator);
+		data.Get(reason_key, ak->reason);
 		ak->nc = NickCore::Find(snc);
-		data["mask"] >> ak->mask;
-		data["addtime"] >> ak->addtime;
-		data["last_used"] >> ak->last_used;
+		data.Get(mask_key, ak->mask);
+		data.Get(addtime_key, ak->addtime);
+		data.Get(last_used_key, ak->last_used);
 	}
 	else
 	{
 		time_t addtime, lastused;
-		data["addtime"] >> addtime;
-		data["last_used"] >> lastused;
+		data.Get(addtime_key, addtime);
+		data.Get(last_used_key, lastused);
 
 		Anope::string screator, sreason, smask;
 
-		data["creator"] >> screator;
-		data["reason"] >> sreason;
-		data["mask"] >> smask;
+		data.Get(creator_key, screator);
+		data.Get(reason_key, sreason);
+		data.Get(mask_key, smask);
 
 		if (nc)
 			ak = ci->AddAkick(screator, nc, sreason, addtime, lastused);
@@ -95,8 +99,94 @@ Serializable* AutoKick::Unserialize(Serializable *obj, Serialize::Data &data)
 	return ak;
 }
 
+/* Incremented whenever the access users have on channels may have changed */
+static unsigned access_generation = 0;
+
+/* How many users' access a channel remembers at once */
+static const unsigned MaxCachedAccess = 1024;
+
+struct ChannelInfo::AccessIndex
+{
+	typedef TR1NS::unordered_multimap<Anope::string, unsigned, Anope::hash_ci, Anope::compare> mask_map;
+	typedef std::map<std::pair<const NickCore *, Anope::string>, std::vector<ChanAccess::Path> > cache_map;
+
+	/* Whether the positions below are up to date with the access list */
+	bool built;
+	/* Positions in the access list of entries for an account */
+	std::multimap<const NickCore *, unsigned> accounts;
+	/* Positions of entries for a mask without wildcards */
+	mask_map masks;
+	/* Positions of everything else, such as wildcard masks and channels, which always have to be checked */
+	std::vector<unsigned> others;
+
+	/* Access found by AccessFor, by account and displayed mask of the user */
+	cache_map cache;
+	unsigned cache_generation;
+
+	AccessIndex() : built(false), cache_generation(access_generation) { }
+
+	void Clear()
+	{
+		this->built = false;
+		this->accounts.clear();
+		this->masks.clear();
+		this->others.clear();
+	}
+
+	void Build(const std::vector<ChanAccess *> &access)
+	{
+		this->Clear();
+
+		for (unsigned i = 0; i < access.size(); ++i)
+		{
+			const ChanAccess *a = access[i];
+			const NickCore *nc = a->GetAccount();
+			const Anope::string &mask = a->Mask();
+
+			if (nc)
+				this->accounts.insert(std::make_pair(nc, i));
+			else if (mask.find_first_of("*?") != Anope::string::npos || (IRCD && IRCD->IsChannelValid(mask)))
+				this->others.push_back(i);
+			else
+				this->masks.insert(std::make_pair(mask, i));
+		}
+
+		this->built = true;
+	}
+
+	void AddMask(const Anope::string &mask, std::vector<unsigned> &positions) const
+	{
+		std::pair<mask_map::const_iterator, mask_map::const_iterator> range = this->masks.equal_range(mask);
+		for (; range.first != range.second; ++range.first)
+			positions.push_back(range.first->second);
+	}
+
+	/* Finds the positions of the entries which could match a user or account, in order */
+	void Find(const User *u, const NickCore *account, std::vector<unsigned> &positions) const
+	{
+		positions = this->others;
+
+		if (u)
+			this->AddMask(u->GetDisplayedMask(), positions);
+
+		if (account)
+		{
+			typedef std::multimap<const NickCore *, unsigned>::const_iterator account_iterator;
+			std::pair<account_iterator, account_iterator> range = this->accounts.equal_range(account);
+			for (; range.first != range.second; ++range.first)
+				positions.push_back(range.first->second);
+
+			for (unsigned i = 0; i < account->aliases->size(); ++i)
+				this->AddMask(account->aliases->at(i)->nick, positions);
+		}
+
+		std::sort(positions.begin(), positions.end());
+		positions.erase(std::unique(positions.begin(), positions.end()), positions.end());
+	}
+};
+
 ChannelInfo::ChannelInfo(const Anope::string &chname) : Serializable("ChannelInfo"),
-	access("ChanAccess"), akick("AutoKick")
+	access("ChanAccess"), akick("AutoKick"), access_index(NULL)
 {
 	if (chname.empty())
 		throw CoreException("Empty channel passed to ChannelInfo constructor");
@@ -121,6 +211,9 @@ ChannelInfo::ChannelInfo(const Anope::string &chname) : Serializable("ChannelInf
 	if (old == RegisteredChannelList->size())
 		Log(LOG_DEBUG) << "Duplicate channel " << this->name << " in registered channel table?";
 
+	/* Access entries for this channel on other channels' access lists now lead here */
+	ClearAccessCache();
+
 	FOREACH_MOD(OnCreateChan, (this));
 }
 
@@ -128,6 +221,7 @@ ChannelInfo::ChannelInfo(const ChannelInfo &ci) : Serializable("ChannelInfo"),
 	access("ChanAccess"), akick("AutoKick")
 {
 	*this = ci;
+	this->access_index = NULL;
 
 	if (this->founder)
 		++this->founder->channelcount;
@@ -176,34 +270,47 @@ ChannelInfo::~ChannelInfo()
 			delete this->memos.GetMemo(i);
 		this->memos.memos->clear();
 	}
+
+	delete this->access_index;
+	ClearAccessCache();
 }
 
+static const Serialize::Key name_key("name"), founder_key("founder"), successor_key("successor"), description_key("description"),
+	time_registered_key("time_registered", Serialize::Data::DT_INT), last_topic_key("last_topic"), last_topic_setter_key("last_topic_setter"),
+	last_topic_time_key("last_topic_time", Serialize::Data::DT_INT), bantype_key("bantype", Serialize::Data::DT_INT), levels_key("levels"),
+	bi_key("bi"), banexpire_key("banexpire", Serialize::Data::DT_INT), memomax_key("memomax"), memoignores_key("memoignores");
+
 void ChannelInfo::Serialize(Serialize::Data &data) const
 {
-	data["name"] << this->name;
+	data.Set(name_key, this->name);
 	if (this->founder)
-		data["founder"] << this->founder->display;
+		data.Set(founder_key, this->founder->display);
 	if (this->successor)
-		data["successor"] << this->successor->display;
-	data["description"] << this->desc;
-	data.SetType("time_registered", Serialize::Data::DT_INT); data["time_registered"] << this->time_registered;
-	data.SetType("last_used", Serialize::Data::DT_INT); data["last_used"] << this->last_used;
-	data["last_topic"] << this->last_topic;
-	data["last_topic_setter"] << this->last_topic_setter;
-	data.SetType("last_topic_time", Serialize::Data::DT_INT); data["last_topic_time"] << this->last_topic_time;
-	data.SetType("bantype", Serialize::Data::DT_INT); data["bantype"] << this->bantype;
+		data.Set(successor_key, this->successor->display);
+	data.Set(description_key, this->desc);
+	data.Set(time_registered_key, this->time_registered);
+	data.Set(last_used_key, this->last_used);
+	data.Set(last_topic_key, this->last_topic);
+	data.Set(last_topic_setter_key, this->last_topic_setter);
+	data.Set(last_topic_time_key, this->last_topic_time);
+	data.Set(bantype_key, this->bantype);
 	{
 		Anope::string levels_buffer;
 		for (Anope::map<int16_t>::const_iterator it = this->levels.begin(), it_end = this->levels.end(); it != it_end; ++it)
 			levels_buffer += it->first + " " + stringify(it->second) + " ";
-		data["levels"] << levels_buffer;
+		data.Set(levels_key, levels_buffer);
 	}
 	if (this->bi)
-		data["bi"] << this->bi->nick;
-	data.SetType("banexpire", Serialize::Data::DT_INT); data["banexpire"] << this->banexpire;
-	data["memomax"] << this->memos.memomax;
-	for (unsigned i = 0; i < this->memos.ignores.size(); ++i)
-		data["memoignores"] << this->memos.ignores[i] << " ";
+		data.Set(bi_key, this->bi->nick);
+	data.Set(banexpire_key, this->banexpire);
+	data.Set(memomax_key, this->memos.memomax);
+	if (!this->memos.ignores.empty())
+	{
+		Anope::string buf;
+		for (unsigned i = 0; i < this->memos.ignores.size(); ++i)
+			buf += this->memos.ignores[i] + " ";
+		data.Set(memoignores_key, buf);
+	}
 
 	Extensible::ExtensibleSerialize(this, this, data);
 }
@@ -212,11 +319,11 @@ Serializable* ChannelInfo::Unserialize(Serializable *obj, Serialize::Data &data)
 {
 	Anope::string sname, sfounder, ssuccessor, slevels, sbi;
 
-	data["name"] >> sname;
-	data["founder"] >> sfounder;
-	data["successor"] >> ssuccessor;
-	data["levels"] >> slevels;
-	data["bi"] >> sbi;
+	data.Get(name_key, sname);
+	data.Get(founder_key, sfounder);
+	data.Get(successor_key, ssuccessor);
+	data.Get(levels_key, slevels);
+	data.Get(bi_key, sbi);
 
 	ChannelInfo *ci;
 	if (obj)
@@ -227,13 +334,13 @@ Serializable* ChannelInfo::Unserialize(Serializable *obj, Serialize::Data &data)
 	ci->SetFounder(NickCore::Find(sfounder));
 	ci->SetSuccessor(NickCore::Find(ssuccessor));
 
-	data["description"] >> ci->desc;
-	data["time_registered"] >> ci->time_registered;
-	data["last_used"] >> ci->last_used;
-	data["last_topic"] >> ci->last_topic;
-	data["last_topic_setter"] >> ci->last_topic_setter;
-	data["last_topic_time"] >> ci->last_topic_time;
-	data["bantype"] >> ci->bantype;
+	data.Get(description_key, ci->desc);
+	data.Get(time_registered_key, ci->time_registered);
+	data.Get(last_used_key, ci->last_used);
+	data.Get(last_topic_key, ci->last_topic);
+	data.Get(last_topic_setter_key, ci->last_topic_setter);
+	data.Get(last_topic_time_key, ci->last_topic_time);
+	data.Get(bantype_key, ci->bantype);
 	{
 		std::vector<Anope::string> v;
 		spacesepstream(slevels).GetTokens(v);
@@ -243,6 +350,7 @@ Serializable* ChannelInfo::Unserialize(Serializable *obj, Serialize::Data &data)
 				ci->levels[v[i]] = convertTo<int16_t>(v[i + 1]);
 			}
 			catch (const ConvertException &) { }
+		PrivilegeManager::ClearCache();
 	}
 	BotInfo *bi = BotInfo::Find(sbi, true);
 	if (*ci->bi != bi)
@@ -252,11 +360,11 @@ Serializable* ChannelInfo::Unserialize(Serializable *obj, Serialize::Data &data)
 		else if (ci->bi)
 			ci->bi->UnAssign(NULL, ci);
 	}
-	data["banexpire"] >> ci->banexpire;
-	data["memomax"] >> ci->memos.memomax;
+	data.Get(banexpire_key, ci->banexpire);
+	data.Get(memomax_key, ci->memos.memomax);
 	{
 		Anope::string buf;
-		data["memoignores"] >> buf;
+		data.Get(memoignores_key, buf);
 		spacesepstream sep(buf);
 		ci->memos.ignores.clear();
 		while (sep.GetToken(buf))
@@ -371,6 +479,7 @@ BotInfo *ChannelInfo::WhoSends() const
 void ChannelInfo::AddAccess(ChanAccess *taccess)
 {
 	this->access->push_back(taccess);
+	this->AccessChanged();
 }
 
 ChanAccess *ChannelInfo::GetAccess(unsigned index) const
@@ -383,14 +492,38 @@ ChanAccess *ChannelInfo::GetAccess(unsigned index) const
 	return acc;
 }
 
-static void FindMatchesRecurse(ChannelInfo *ci, const User *u, const NickCore *account, unsigned int depth, std::vector<ChanAccess::Path> &paths, ChanAccess::Path &path)
+void ChannelInfo::AccessChanged()
+{
+	if (this->access_index)
+		this->access_index->Clear();
+	ClearAccessCache();
+}
+
+void ChannelInfo::ClearAccessCache()
+{
+	++access_generation;
+}
+
+void ChannelInfo::FindAccess(const User *u, const NickCore *account, unsigned int depth, std::vector<ChanAccess::Path> &paths, ChanAccess::Path &path)
 {
 	if (depth > ChanAccess::MAX_DEPTH)
 		return;
 
-	for (unsigned int i = 0; i < ci->GetAccessCount(); ++i)
+	/* This also applies any changes to the access list from the database */
+	if (this->access->empty())
+		return;
+
+	if (!this->access_index)
+		this->access_index = new AccessIndex();
+	if (!this->access_index->built)
+		this->access_index->Build(*this->access);
+
+	std::vector<unsigned> positions;
+	this->access_index->Find(u, account, positions);
+
+	for (unsigned int i = 0; i < positions.size(); ++i)
 	{
-		ChanAccess *a = ci->GetAccess(i);
+		ChanAccess *a = this->GetAccess(positions[i]);
 		ChannelInfo *next = NULL;
 
 		if (a->Matches(u, account, next))
@@ -405,15 +538,44 @@ static void FindMatchesRecurse(ChannelInfo *ci, const User *u, const NickCore *a
 			ChanAccess::Path next_path = path;
 			next_path.push_back(a);
 
-			FindMatchesRecurse(next, u, account, depth + 1, paths, next_path);
+			next->FindAccess(u, account, depth + 1, paths, next_path);
 		}
 	}
 }
 
-static void FindMatches(AccessGroup &group, ChannelInfo *ci, const User *u, const NickCore *account)
+void ChannelInfo::FindAccess(const User *u, const NickCore *account, std::vector<ChanAccess::Path> &paths)
 {
+	/* Apply any changes from the database before trusting the cache */
+	static_cast<void>(this->access->size());
+	if (account)
+		static_cast<void>(account->aliases->size());
+
+	if (!this->access_index)
+		this->access_index = new AccessIndex();
+
+	AccessIndex::cache_map &cache = this->access_index->cache;
+	if (this->access_index->cache_generation != access_generation || cache.size() >= MaxCachedAccess)
+	{
+		cache.clear();
+		this->access_index->cache_generation = access_generation;
+	}
+
+	std::pair<const NickCore *, Anope::string> key(account, u ? u->GetDisplayedMask() : "");
+	AccessIndex::cache_map::const_iterator it = cache.find(key);
+	if (it != cache.end())
+	{
+		paths = it->second;
+		return;
+	}
+
+	unsigned start_generation = access_generation;
+
 	ChanAccess::Path path;
-	FindMatchesRecurse(ci, u, account, 0, group.paths, path);
+	this->FindAccess(u, account, 0, paths, path);
+
+	/* Don't remember this if the database changed something while looking */
+	if (start_generation == access_generation)
+		cache[key] = paths;
 }
 
 AccessGroup ChannelInfo::AccessFor(const User *u, bool updateLastUsed)
@@ -436,19 +598,25 @@ AccessGroup ChannelInfo::AccessFor(const User *u, bool updateLastUsed)
 	group.ci = this;
 	group.nc = nc;
 
-	FindMatches(group, this, u, u->Account());
+	this->FindAccess(u, u->Account(), group.paths);
 
 	if (group.founder || !group.paths.empty())
 	{
 		if (updateLastUsed)
+		{
+			this->QueueUpdate();
 			this->last_used = Anope::CurTime;
+		}
 
 		for (unsigned i = 0; i < group.paths.size(); ++i)
 		{
 			ChanAccess::Path &p = group.paths[i];
 
 			for (unsigned int j = 0; j < p.size(); ++j)
+			{
 				p[j]->last_seen = Anope::CurTime;
+				p[j]->QueueUpdate();
+			}
 		}
 	}
 
@@ -463,11 +631,14 @@ AccessGroup ChannelInfo::AccessFor(const NickCore *nc, bool updateLastUsed)
 	group.ci = this;
 	group.nc = nc;
 
-	FindMatches(group, this, NULL, nc);
+	this->FindAccess(NULL, nc, group.paths);
 
 	if (group.founder || !group.paths.empty())
 		if (updateLastUsed)
+		{
+			this->QueueUpdate();
 			this->last_used = Anope::CurTime;
+		}
 
 	/* don't update access last seen here, this isn't the user requesting access */
 
@@ -516,6 +687,7 @@ ChanAccess *ChannelInfo::EraseAccess(unsigned index)
 
 	ChanAccess *ca = this->access->at(index);
 	this->access->erase(this->access->begin() + index);
+	this->AccessChanged();
 	return ca;
 }
 
@@ -615,16 +787,19 @@ void ChannelInfo::SetLevel(const Anope::string &priv, int16_t level)
 	}
 
 	this->levels[priv] = level;
+	PrivilegeManager::ClearCache();
 }
 
 void ChannelInfo::RemoveLevel(const Anope::string &priv)
 {
 	this->levels.erase(priv);
+	PrivilegeManager::ClearCache();
 }
 
 void ChannelInfo::ClearLevels()
 {
 	this->levels.clear();
+	PrivilegeManager::ClearCache();
 }
 
 Anope::string ChannelInfo::GetIdealBan(User *u) const
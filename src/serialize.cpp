@@ -24,6 +24,9 @@ using namespace Serialize;
 std::vector<Anope::string> Type::TypeOrder;
 std::map<Anope::string, Type *> Serialize::Type::Types;
 std::list<Serializable *> *Serializable::SerializableItems;
+std::set<Serializable *> *Serializable::DirtyItems;
+/* Every interned key name, and its id. On the heap for the same reason as SerializableItems */
+static std::map<Anope::string, unsigned> *KeyNames;
 
 void Serialize::RegisterTypes()
 {
@@ -32,6 +35,22 @@ void Serialize::RegisterTypes()
 		akick("AutoKick", AutoKick::Unserialize), memo("Memo", Memo::Unserialize), xline("XLine", XLine::Unserialize);
 }
 
+Key::Key(const Anope::string &n, Data::Type t) : type(t)
+{
+	if (KeyNames == NULL)
+		KeyNames = new std::map<Anope::string, unsigned>();
+
+	unsigned next = KeyNames->size();
+	std::map<Anope::string, unsigned>::iterator it = KeyNames->insert(std::make_pair(n, next)).first;
+	this->name = &it->first;
+	this->id = it->second;
+}
+
+unsigned Key::GetCount()
+{
+	return KeyNames ? KeyNames->size() : 0;
+}
+
 void Serialize::CheckTypes()
 {
 	for (std::map<Anope::string, Serialize::Type *>::const_iterator it = Serialize::Type::GetTypes().begin(), it_end = Serialize::Type::GetTypes().end(); it != it_end; ++it)
@@ -41,10 +60,12 @@ void Serialize::CheckTypes()
 	}
 }
 
-Serializable::Serializable(const Anope::string &serialize_type) : last_commit(0), last_commit_time(0), id(0), redis_ignore(0)
+Serializable::Serializable(const Anope::string &serialize_type) : last_commit(0), last_commit_time(0), generation(0), commit_generation(0), id(0), redis_ignore(0)
 {
 	if (SerializableItems == NULL)
 		SerializableItems = new std::list<Serializable *>();
+	if (DirtyItems == NULL)
+		DirtyItems = new std::set<Serializable *>();
 	SerializableItems->push_back(this);
 
 	this->s_type = Type::Find(serialize_type);
@@ -55,7 +76,7 @@ Serializable::Serializable(const Anope::string &serialize_type) : last_commit(0)
 	FOREACH_MOD(OnSerializableConstruct, (this));
 }
 
-Serializable::Serializable(const Serializable &other) : last_commit(0), last_commit_time(0), id(0), redis_ignore(0)
+Serializable::Serializable(const Serializable &other) : last_commit(0), last_commit_time(0), generation(0), commit_generation(0), id(0), redis_ignore(0)
 {
 	SerializableItems->push_back(this);
 	this->s_iter = SerializableItems->end();
@@ -71,6 +92,8 @@ Serializable::~Serializable()
 	FOREACH_MOD(OnSerializableDestruct, (this));
 
 	SerializableItems->erase(this->s_iter);
+	if (this->IsDirty())
+		DirtyItems->erase(this);
 }
 
 Serializable &Serializable::operator=(const Serializable &)
@@ -80,8 +103,19 @@ Serializable &Serializable::operator=(const Serializable &)
 
 void Serializable::QueueUpdate()
 {
-	/* Schedule updater */
-	FOREACH_MOD(OnSerializableUpdate, (this));
+	bool was_dirty = this->IsDirty();
+
+	++this->generation;
+	if (this->generation == this->commit_generation)
+		/* Wrapped around, don't let this look committed */
+		++this->generation;
+
+	/* Schedule updater, unless it has already been since this was last committed */
+	if (!was_dirty)
+	{
+		DirtyItems->insert(this);
+		FOREACH_MOD(OnSerializableUpdate, (this));
+	}
 
 	/* Check for modifications now - this can delete this object! */
 	FOREACH_MOD(OnSerializeCheck, (this->GetSerializableType()));
@@ -92,9 +126,19 @@ bool Serializable::IsCached(Serialize::Data &data)
 	return this->last_commit == data.Hash();
 }
 
+void Serializable::Commit()
+{
+	if (this->IsDirty())
+	{
+		DirtyItems->erase(this);
+		this->commit_generation = this->generation;
+	}
+}
+
 void Serializable::UpdateCache(Serialize::Data &data)
 {
 	this->last_commit = data.Hash();
+	this->Commit();
 }
 
 bool Serializable::IsTSCached()
@@ -112,6 +156,11 @@ const std::list<Serializable *> &Serializable::GetItems()
 	return *SerializableItems;
 }
 
+const std::set<Serializable *> &Serializable::GetDirtyItems()
+{
+	return *DirtyItems;
+}
+
 Type::Type(const Anope::string &n, unserialize_func f, Module *o)  : name(n), unserialize(f), owner(o), timestamp(0)
 {
 	TypeOrder.push_back(this->name);
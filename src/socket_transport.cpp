@@ -13,7 +13,104 @@
 #include "sockets.h"
 #include "socketengine.h"
 
-BufferedSocket::BufferedSocket()
+const size_t SendQueue::BlockSize;
+
+SendQueue::SendQueue() : length(0)
+{
+	spare.data = NULL;
+	spare.start = spare.end = spare.size = 0;
+}
+
+SendQueue::~SendQueue()
+{
+	for (unsigned i = 0; i < blocks.size(); ++i)
+		delete [] blocks[i].data;
+	delete [] spare.data;
+}
+
+void SendQueue::Append(const char *buf, size_t len)
+{
+	length += len;
+
+	if (!blocks.empty())
+	{
+		Block &b = blocks.back();
+		size_t n = std::min(len, b.size - b.end);
+		memcpy(b.data + b.end, buf, n);
+		b.end += n;
+		buf += n;
+		len -= n;
+	}
+
+	if (!len)
+		return;
+
+	Block b;
+	if (spare.data && len <= spare.size)
+	{
+		b = spare;
+		spare.data = NULL;
+		spare.size = 0;
+	}
+	else
+	{
+		b.size = std::max(len, BlockSize);
+		b.data = new char[b.size];
+	}
+	memcpy(b.data, buf, len);
+	b.start = 0;
+	b.end = len;
+	blocks.push_back(b);
+}
+
+void SendQueue::Consume(size_t len)
+{
+	length -= std::min(len, length);
+
+	while (len && !blocks.empty())
+	{
+		Block &b = blocks.front();
+		size_t n = std::min(len, b.end - b.start);
+		b.start += n;
+		len -= n;
+
+		if (b.start == b.end)
+		{
+			if (!spare.data && b.size == BlockSize)
+			{
+				spare = b;
+				spare.start = spare.end = 0;
+			}
+			else
+				delete [] b.data;
+			blocks.pop_front();
+		}
+	}
+}
+
+int SendQueue::GetBuffers(iovec *iov, int count) const
+{
+	int i = 0;
+	for (std::deque<Block>::const_iterator it = blocks.begin(), it_end = blocks.end(); it != it_end && i < count; ++it, ++i)
+	{
+		iov[i].iov_base = it->data + it->start;
+		iov[i].iov_len = it->end - it->start;
+	}
+	return i;
+}
+
+int SendQueue::Flush(Socket *s)
+{
+	iovec iov[64];
+	int count = this->GetBuffers(iov, sizeof(iov) / sizeof(*iov));
+
+	int len = s->io->Send(s, iov, count);
+	if (len > 0)
+		this->Consume(len);
+	return len;
+}
+
+BufferedSocket::BufferedSocket() : read_offset(0), recv_len(0), corked(0)
 {
 }
 
@@ -23,18 +120,28 @@ BufferedSocket::~BufferedSocket()
 
 bool BufferedSocket::ProcessRead()
 {
-	char tbuffer[NET_BUFSIZE];
+	std::string &buf = this->read_buffer.str();
+
+	/* Drop the lines consumed since the last read, so only a partial line is ever moved */
+	if (this->read_offset)
+	{
+		buf.erase(0, this->read_offset);
+		this->read_offset = 0;
+	}
 
 	this->recv_len = 0;
 
-	int len = this->io->Recv(this, tbuffer, sizeof(tbuffer) - 1);
+	size_t old_len = buf.length();
+	buf.resize(old_len + NET_BUFSIZE);
+
+	int len = this->io->Recv(this, &buf[old_len], NET_BUFSIZE);
+	buf.resize(old_len + std::max(len, 0));
+
 	if (len == 0)
 		return false;
 	if (len < 0)
 		return SocketEngine::IgnoreErrno();
 
-	tbuffer[len] = 0;
-	this->read_buffer.append(tbuffer);
 	this->recv_len = len;
 
 	return true;
@@ -42,13 +149,12 @@ bool BufferedSocket::ProcessRead()
 
 bool BufferedSocket::ProcessWrite()
 {
-	int count = this->io->Send(this, this->write_buffer);
+	int count = this->write_buffer.Flush(this);
 	if (count == 0)
 		return false;
 	if (count < 0)
 		return SocketEngine::IgnoreErrno();
 
-	this->write_buffer = this->write_buffer.substr(count);
 	if (this->write_buffer.empty())
 		SocketEngine::Change(this, false, SF_WRITABLE);
 
@@ -57,19 +163,47 @@ bool BufferedSocket::ProcessWrite()
 
 const Anope::string BufferedSocket::GetLine()
 {
-	size_t s = this->read_buffer.find('\n');
-	if (s == Anope::string::npos)
+	const char *line;
+	size_t len;
+	if (!this->GetLine(line, len))
 		return "";
-	Anope::string str = this->read_buffer.substr(0, s + 1);
-	this->read_buffer.erase(0, s + 1);
-	this->read_buffer.ltrim("\r\n");
-	return str.trim("\r\n");
+	return Anope::string(line, len);
+}
+
+bool BufferedSocket::GetLine(const char *&line, size_t &len)
+{
+	const char *buf = this->read_buffer.c_str(), *end = buf + this->read_buffer.length();
+
+	for (;;)
+	{
+		const char *start = buf + this->read_offset;
+		const char *nl = static_cast<const char *>(memchr(start, '\n', end - start));
+		if (nl == NULL)
+			return false;
+
+		this->read_offset = nl + 1 - buf;
+
+		/* Strip the line terminator, and skip empty lines */
+		const char *last = nl;
+		while (last > start && (last[-1] == '\r' || last[-1] == '\n'))
+			--last;
+		while (start < last && (*start == '\r' || *start == '\n'))
+			++start;
+		if (start == last)
+			continue;
+
+		line = start;
+		len = last - start;
+		return true;
+	}
 }
 
 void BufferedSocket::Write(const char *buffer, size_t l)
 {
-	this->write_buffer += buffer + Anope::string("\r\n");
-	SocketEngine::Change(this, true, SF_WRITABLE);
+	this->write_buffer.Append(buffer, l);
+	this->write_buffer.Append("\r\n", 2);
+	if (!this->corked)
+		SocketEngine::Change(this, true, SF_WRITABLE);
 }
 
 void BufferedSocket::Write(const char *message, ...)
@@ -84,7 +218,7 @@ void BufferedSocket::Write(const char *message, ...)
 	int len = vsnprintf(tbuffer, sizeof(tbuffer), message, vi);
 	va_end(vi);
 
-	this->Write(tbuffer, std::min(len, static_cast<int>(sizeof(tbuffer))));
+	this->Write(tbuffer, std::min(len, static_cast<int>(sizeof(tbuffer) - 1)));
 }
 
 void BufferedSocket::Write(const Anope::string &message)
@@ -92,27 +226,33 @@ void BufferedSocket::Write(const Anope::string &message)
 	this->Write(message.c_str(), message.length());
 }
 
-int BufferedSocket::ReadBufferLen() const
+void BufferedSocket::Cork()
 {
-	return recv_len;
+	++this->corked;
 }
 
-int BufferedSocket::WriteBufferLen() const
+void BufferedSocket::Uncork()
 {
-	return this->write_buffer.length();
-}
+	if (!this->corked || --this->corked || this->write_buffer.empty())
+		return;
+
+	/* Try to send everything now instead of waiting for the socket engine to say we are writable,
+	 * any errors are left for ProcessWrite() to find.
+	 */
+	if (this->flags[SF_CONNECTED] || this->flags[SF_ACCEPTED])
+		this->write_buffer.Flush(this);
 
+	SocketEngine::Change(this, !this->write_buffer.empty(), SF_WRITABLE);
+}
 
-BinarySocket::DataBlock::DataBlock(const char *b, size_t l)
+int BufferedSocket::ReadBufferLen() const
 {
-	this->orig = this->buf = new char[l];
-	memcpy(this->buf, b, l);
-	this->len = l;
+	return recv_len;
 }
 
-BinarySocket::DataBlock::~DataBlock()
+int BufferedSocket::WriteBufferLen() const
 {
-	delete [] this->orig;
+	return this->write_buffer.size();
 }
 
 BinarySocket::BinarySocket()
@@ -142,21 +282,9 @@ bool BinarySocket::ProcessWrite()
 		return true;
 	}
 
-	DataBlock *d = this->write_buffer.front();
-
-	int len = this->io->Send(this, d->buf, d->len);
+	int len = this->write_buffer.Flush(this);
 	if (len <= -1)
 		return false;
-	else if (static_cast<size_t>(len) == d->len)
-	{
-		delete d;
-		this->write_buffer.pop_front();
-	}
-	else
-	{
-		d->buf += len;
-		d->len -= len;
-	}
 
 	if (this->write_buffer.empty())
 		SocketEngine::Change(this, false, SF_WRITABLE);
@@ -168,7 +296,7 @@ void BinarySocket::Write(const char *buffer, size_t l)
 {
 	if (l == 0)
 		return;
-	this->write_buffer.push_back(new DataBlock(buffer, l));
+	this->write_buffer.Append(buffer, l);
 	SocketEngine::Change(this, true, SF_WRITABLE);
 }
 
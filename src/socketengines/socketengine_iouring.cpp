@@ -0,0 +1,337 @@
+/*
+ *
+ * (C) 2003-2018 Anope Team
+ * Contact us at team@anope.org
+ *
+ * Please read COPYING and README for further details.
+ *
+ * Based on the original code of Epona by Lara.
+ * Based on the original code of Services by Andy Church.
+ */
+
+#include "services.h"
+#include "anope.h"
+#include "sockets.h"
+#include "socketengine.h"
+#include "config.h"
+#include "timers.h"
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <poll.h>
+#include <endian.h>
+#include <errno.h>
+
+/* Sockets are polled with one shot IORING_OP_POLL_ADD requests. Changes to a socket's
+ * flags only mark it dirty, and all of the (re)arm and remove requests built up during
+ * a loop are submitted together with the wait for completions in one io_uring_enter().
+ * Requests are tagged with a generation in the upper half of their user_data so that
+ * completions for polls which have since been removed (or whose fd has been reused) are
+ * ignored.
+ */
+
+static const unsigned RingEntries = 1024;
+
+struct PollState
+{
+	uint64_t user_data;
+	unsigned mask;
+};
+
+static int EngineHandle = -1;
+static io_uring_params params;
+
+static void *sq_ring, *cq_ring;
+static size_t sq_ring_size, cq_ring_size;
+static io_uring_sqe *sqes;
+static size_t sqes_size;
+
+static unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+static unsigned *cq_head, *cq_tail, *cq_mask;
+static io_uring_cqe *cqes;
+
+static unsigned local_tail, pending;
+static uint32_t generation;
+
+/* Polls currently submitted to the kernel, by fd */
+static std::map<int, PollState> armed;
+/* Sockets whose poll needs to be (re)armed before the next wait */
+static std::set<int> dirty;
+static std::vector<io_uring_cqe> completions;
+
+static int Enter(unsigned to_submit, unsigned min_complete, unsigned flags, void *arg, size_t argsz)
+{
+	return syscall(__NR_io_uring_enter, EngineHandle, to_submit, min_complete, flags, arg, argsz);
+}
+
+static void Submit()
+{
+	while (pending)
+	{
+		int ret = Enter(pending, 0, 0, NULL, 0);
+		if (ret < 0)
+		{
+			if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+				continue;
+			throw SocketException("Unable to submit to io_uring: " + Anope::LastError());
+		}
+		pending -= ret;
+	}
+}
+
+static io_uring_sqe *GetSQE()
+{
+	if (local_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= *sq_mask + 1)
+		Submit();
+
+	unsigned index = local_tail & *sq_mask;
+	io_uring_sqe *sqe = &sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	sq_array[index] = index;
+
+	++local_tail;
+	++pending;
+
+	return sqe;
+}
+
+static void Publish()
+{
+	__atomic_store_n(sq_tail, local_tail, __ATOMIC_RELEASE);
+}
+
+static void QueueRemove(const PollState &st)
+{
+	io_uring_sqe *sqe = GetSQE();
+	sqe->opcode = IORING_OP_POLL_REMOVE;
+	sqe->fd = -1;
+	sqe->addr = st.user_data;
+	/* user_data 0 is never used by poll requests, so these completions are ignored */
+	sqe->user_data = 0;
+	Publish();
+}
+
+static void QueueAdd(int fd, unsigned mask)
+{
+	if (++generation == 0)
+		++generation;
+
+	PollState &st = armed[fd];
+	st.user_data = (static_cast<uint64_t>(generation) << 32) | static_cast<uint32_t>(fd);
+	st.mask = mask;
+
+	io_uring_sqe *sqe = GetSQE();
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = fd;
+#if __BYTE_ORDER == __BIG_ENDIAN
+	sqe->poll32_events = (mask << 16) | (mask >> 16);
+#else
+	sqe->poll32_events = mask;
+#endif
+	sqe->user_data = st.user_data;
+	Publish();
+}
+
+static unsigned WantedMask(Socket *s)
+{
+	return (s->flags[SF_READABLE] ? POLLIN : 0) | (s->flags[SF_WRITABLE] ? POLLOUT : 0);
+}
+
+void SocketEngine::Init()
+{
+	memset(&params, 0, sizeof(params));
+
+	EngineHandle = syscall(__NR_io_uring_setup, RingEntries, &params);
+	if (EngineHandle == -1)
+		throw SocketException("Could not initialize io_uring socket engine: " + Anope::LastError());
+
+	if (!(params.features & IORING_FEAT_EXT_ARG))
+		throw SocketException("Could not initialize io_uring socket engine: kernel does not support IORING_FEAT_EXT_ARG (Linux 5.11 or later is required)");
+
+	sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+		sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+
+	sq_ring = mmap(NULL, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, EngineHandle, IORING_OFF_SQ_RING);
+	if (sq_ring == MAP_FAILED)
+		throw SocketException("Could not map io_uring submission queue: " + Anope::LastError());
+
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+		cq_ring = sq_ring;
+	else
+	{
+		cq_ring = mmap(NULL, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, EngineHandle, IORING_OFF_CQ_RING);
+		if (cq_ring == MAP_FAILED)
+			throw SocketException("Could not map io_uring completion queue: " + Anope::LastError());
+	}
+
+	sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+	sqes = static_cast<io_uring_sqe *>(mmap(NULL, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, EngineHandle, IORING_OFF_SQES));
+	if (sqes == MAP_FAILED)
+		throw SocketException("Could not map io_uring submission entries: " + Anope::LastError());
+
+	char *sq = static_cast<char *>(sq_ring), *cq = static_cast<char *>(cq_ring);
+	sq_head = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+	sq_tail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+	sq_mask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+	sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+	cq_head = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+	cq_tail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+	cq_mask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+	cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+
+	local_tail = *sq_tail;
+	pending = 0;
+}
+
+void SocketEngine::Shutdown()
+{
+	while (!Sockets.empty())
+		delete Sockets.begin()->second;
+
+	armed.clear();
+	dirty.clear();
+
+	munmap(sqes, sqes_size);
+	if (cq_ring != sq_ring)
+		munmap(cq_ring, cq_ring_size);
+	munmap(sq_ring, sq_ring_size);
+	close(EngineHandle);
+	EngineHandle = -1;
+}
+
+void SocketEngine::Change(Socket *s, bool set, SocketFlag flag)
+{
+	if (set == s->flags[flag])
+		return;
+
+	s->flags[flag] = set;
+
+	int fd = s->GetFD();
+
+	if (!s->flags[SF_READABLE] && !s->flags[SF_WRITABLE])
+	{
+		/* The socket is most likely about to be closed, so the poll must be
+		 * removed now before the fd can be reused by another socket.
+		 */
+		std::map<int, PollState>::iterator it = armed.find(fd);
+		if (it != armed.end())
+		{
+			QueueRemove(it->second);
+			armed.erase(it);
+		}
+		dirty.erase(fd);
+		return;
+	}
+
+	dirty.insert(fd);
+}
+
+void SocketEngine::Process()
+{
+	for (std::set<int>::iterator it = dirty.begin(), it_end = dirty.end(); it != it_end; ++it)
+	{
+		int fd = *it;
+
+		std::map<int, Socket *>::iterator sit = Sockets.find(fd);
+		if (sit == Sockets.end())
+			continue;
+
+		unsigned mask = WantedMask(sit->second);
+
+		std::map<int, PollState>::iterator ait = armed.find(fd);
+		if (ait != armed.end())
+		{
+			if (ait->second.mask == mask)
+				continue;
+
+			QueueRemove(ait->second);
+			armed.erase(ait);
+		}
+
+		if (mask)
+			QueueAdd(fd, mask);
+	}
+	dirty.clear();
+
+	long timeout = TimerManager::GetTimeout(Config->ReadTimeout * 1000);
+	__kernel_timespec ts;
+	ts.tv_sec = timeout / 1000;
+	ts.tv_nsec = (timeout % 1000) * 1000000;
+
+	io_uring_getevents_arg arg;
+	memset(&arg, 0, sizeof(arg));
+	arg.ts = reinterpret_cast<uint64_t>(&ts);
+
+	int ret = Enter(pending, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+	Anope::CurTime = time(NULL);
+
+	if (ret >= 0)
+		pending -= std::min(pending, static_cast<unsigned>(ret));
+	/* ETIME is given if the read timeout expires, EINTR if we are interrupted by a signal */
+	else if (errno != ETIME && errno != EINTR)
+	{
+		Log() << "SockEngine::Process(): error: " << Anope::LastError();
+		return;
+	}
+
+	/* Copy the completions out first as processing sockets may queue more submissions */
+	completions.clear();
+	unsigned head = *cq_head, tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+	for (; head != tail; ++head)
+		completions.push_back(cqes[head & *cq_mask]);
+	__atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+
+	for (unsigned i = 0; i < completions.size(); ++i)
+	{
+		const io_uring_cqe &cqe = completions[i];
+
+		if (!cqe.user_data)
+			continue;
+
+		int fd = static_cast<int>(cqe.user_data & 0xFFFFFFFF);
+
+		std::map<int, PollState>::iterator ait = armed.find(fd);
+		if (ait == armed.end() || ait->second.user_data != cqe.user_data)
+			continue;
+
+		/* This poll has fired and is no longer armed */
+		armed.erase(ait);
+
+		std::map<int, Socket *>::iterator it = Sockets.find(fd);
+		if (it == Sockets.end())
+			continue;
+		Socket *s = it->second;
+
+		dirty.insert(fd);
+
+		if (cqe.res < 0)
+			continue;
+
+		if (cqe.res & (POLLHUP | POLLERR))
+		{
+			s->ProcessError();
+			delete s;
+			continue;
+		}
+
+		if (!s->Process())
+		{
+			if (s->flags[SF_DEAD])
+				delete s;
+			continue;
+		}
+
+		if ((cqe.res & POLLIN) && !s->ProcessRead())
+			s->flags[SF_DEAD] = true;
+
+		if ((cqe.res & POLLOUT) && !s->ProcessWrite())
+			s->flags[SF_DEAD] = true;
+
+		if (s->flags[SF_DEAD])
+			delete s;
+	}
+}
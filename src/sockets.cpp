@@ -369,15 +369,21 @@ size_t cidr::hash::operator()(const cidr &s) const
 		}
 		case AF_INET6:
 		{
-			size_t h = 0;
+			/* Every byte of the prefix has to go into the hash, sessions are commonly
+			 * grouped by /64 or more and these must not all end up in a few buckets.
+			 */
+			unsigned len = std::min<unsigned>(s.cidr_len, 128);
+			size_t h = 5381;
 
-			for (unsigned i = 0; i < s.cidr_len / 8; ++i)
-				h ^= (s.addr.sa6.sin6_addr.s6_addr[i] << ((i * 8) % sizeof(size_t)));
+			for (unsigned i = 0; i < len / 8; ++i)
+				h = (h << 5) + h + s.addr.sa6.sin6_addr.s6_addr[i];
 
-			int remaining = s.cidr_len % 8;
-			unsigned char m = 0xFF << (8 - remaining);
-
-			h ^= s.addr.sa6.sin6_addr.s6_addr[s.cidr_len / 8] & m;
+			int remaining = len % 8;
+			if (remaining)
+			{
+				unsigned char m = 0xFF << (8 - remaining);
+				h = (h << 5) + h + (s.addr.sa6.sin6_addr.s6_addr[len / 8] & m);
+			}
 
 			return h;
 		}
@@ -407,6 +413,32 @@ int SocketIO::Send(Socket *s, const Anope::string &buf)
 	return this->Send(s, buf.c_str(), buf.length());
 }
 
+int SocketIO::Send(Socket *s, const iovec *iov, int iovcnt)
+{
+#ifndef _WIN32
+	if (this == &NormalSocketIO)
+	{
+		int i = writev(s->GetFD(), iov, iovcnt);
+		if (i > 0)
+			TotalWritten += i;
+		return i;
+	}
+#endif
+
+	/* Other socket IO (such as SSL) may only know how to send one buffer at a time */
+	int total = 0;
+	for (int j = 0; j < iovcnt; ++j)
+	{
+		int i = this->Send(s, static_cast<const char *>(iov[j].iov_base), iov[j].iov_len);
+		if (i <= 0)
+			return total ? total : i;
+		total += i;
+		if (static_cast<size_t>(i) < iov[j].iov_len)
+			break;
+	}
+	return total;
+}
+
 ClientSocket *SocketIO::Accept(ListenSocket *s)
 {
 	sockaddrs conaddr;
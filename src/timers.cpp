@@ -9,7 +9,14 @@
 #include "services.h"
 #include "timers.h"
 
-std::multimap<time_t, Timer *> TimerManager::Timers;
+#ifndef _WIN32
+#include <sys/time.h>
+#endif
+
+TimerManager::Slot TimerManager::Wheel[TimerManager::Levels][TimerManager::Slots];
+TimerManager::Slot TimerManager::Overflow;
+unsigned TimerManager::LevelCount[TimerManager::Levels];
+time_t TimerManager::WheelTime = 0;
 
 Timer::Timer(long time_from_now, time_t now, bool repeating)
 {
@@ -18,6 +25,8 @@ Timer::Timer(long time_from_now, time_t now, bool repeating)
 	secs = time_from_now;
 	repeat = repeating;
 	settime = now;
+	level = slot = -1;
+	prev = next = NULL;
 
 	TimerManager::AddTimer(this);
 }
@@ -29,6 +38,8 @@ Timer::Timer(Module *creator, long time_from_now, time_t now, bool repeating)
 	secs = time_from_now;
 	repeat = repeating;
 	settime = now;
+	level = slot = -1;
+	prev = next = NULL;
 
 	TimerManager::AddTimer(this);
 }
@@ -78,49 +89,217 @@ Module *Timer::GetOwner() const
 	return owner;
 }
 
+void TimerManager::Link(Slot &s, Timer *t)
+{
+	t->prev = s.tail;
+	t->next = NULL;
+	if (s.tail)
+		s.tail->next = t;
+	else
+		s.head = t;
+	s.tail = t;
+}
+
+void TimerManager::Unlink(Timer *t)
+{
+	Slot &s = t->level < Levels ? Wheel[t->level][t->slot] : Overflow;
+
+	if (t->prev)
+		t->prev->next = t->next;
+	else
+		s.head = t->next;
+	if (t->next)
+		t->next->prev = t->prev;
+	else
+		s.tail = t->prev;
+
+	if (t->level < Levels)
+		--LevelCount[t->level];
+
+	t->level = t->slot = -1;
+	t->prev = t->next = NULL;
+}
+
 void TimerManager::AddTimer(Timer *t)
 {
-	Timers.insert(std::make_pair(t->GetTimer(), t));
+	if (t->level != -1)
+		return;
+
+	if (!WheelTime)
+		WheelTime = Anope::CurTime;
+
+	/* Timers which are already due go in the current slot, so they are run on the next tick */
+	time_t when = std::max(t->GetTimer(), WheelTime);
+
+	/* Find the lowest level on which the trigger time shares its slot on the level above with the current time */
+	int level = 0;
+	while (level < Levels && ((when ^ WheelTime) >> (LevelBits * (level + 1))) != 0)
+		++level;
+
+	if (level == Levels)
+	{
+		t->level = Levels;
+		t->slot = 0;
+		Link(Overflow, t);
+		return;
+	}
+
+	t->level = level;
+	t->slot = static_cast<int>((when >> (LevelBits * level)) & (Slots - 1));
+	Link(Wheel[level][t->slot], t);
+	++LevelCount[level];
 }
 
 void TimerManager::DelTimer(Timer *t)
 {
-	std::pair<std::multimap<time_t, Timer *>::iterator, std::multimap<time_t, Timer *>::iterator> itpair = Timers.equal_range(t->GetTimer());
-	for (std::multimap<time_t, Timer *>::iterator i = itpair.first; i != itpair.second; ++i)
+	if (t->level != -1)
+		Unlink(t);
+}
+
+void TimerManager::Cascade(Slot &s)
+{
+	Timer *t = s.head;
+	while (t)
 	{
-		if (i->second == t)
+		Timer *next = t->next;
+		Unlink(t);
+		AddTimer(t);
+		t = next;
+	}
+}
+
+void TimerManager::Advance(time_t ctime)
+{
+	/* If the lower levels are empty, skip straight to the end of their rotation */
+	int empty = 0;
+	while (empty < Levels && !LevelCount[empty])
+		++empty;
+
+	if (empty == Levels && !Overflow.head)
+	{
+		WheelTime = ctime;
+		return;
+	}
+
+	if (empty > 0)
+	{
+		time_t end = WheelTime | ((static_cast<time_t>(1) << (LevelBits * empty)) - 1);
+		if (end >= ctime)
 		{
-			Timers.erase(i);
-			break;
+			WheelTime = ctime;
+			return;
 		}
+		WheelTime = end;
 	}
+
+	++WheelTime;
+
+	/* Move the timers of any higher level slots which have come due down the wheel, highest first */
+	if ((WheelTime & ((static_cast<time_t>(1) << (LevelBits * Levels)) - 1)) == 0)
+		Cascade(Overflow);
+	for (int level = Levels - 1; level > 0; --level)
+		if ((WheelTime & ((static_cast<time_t>(1) << (LevelBits * level)) - 1)) == 0)
+			Cascade(Wheel[level][(WheelTime >> (LevelBits * level)) & (Slots - 1)]);
 }
 
 void TimerManager::TickTimers(time_t ctime)
 {
-	while (!Timers.empty())
+	if (!WheelTime)
+		WheelTime = ctime;
+
+	for (;;)
 	{
-		std::multimap<time_t, Timer *>::iterator it = Timers.begin();
-		Timer *t = it->second;
+		Slot &s = Wheel[0][WheelTime & (Slots - 1)];
 
-		if (t->GetTimer() > ctime)
-			break;
+		while (s.head)
+		{
+			Timer *t = s.head;
+			Unlink(t);
 
-		t->Tick(ctime);
+			t->Tick(ctime);
+
+			if (t->GetRepeat())
+				t->SetTimer(ctime + t->GetSecs());
+			else
+				delete t;
+		}
+
+		if (WheelTime >= ctime)
+			break;
 
-		if (t->GetRepeat())
-			t->SetTimer(ctime + t->GetSecs());
-		else
-			delete t;
+		Advance(ctime);
 	}
 }
 
 void TimerManager::DeleteTimersFor(Module *m)
 {
-	for (std::multimap<time_t, Timer *>::iterator it = Timers.begin(), it_next = it; it != Timers.end(); it = it_next)
+	for (int level = 0; level <= Levels; ++level)
+		for (int slot = 0; slot < (level < Levels ? Slots : 1); ++slot)
+		{
+			Slot &s = level < Levels ? Wheel[level][slot] : Overflow;
+
+			for (Timer *t = s.head, *next; t; t = next)
+			{
+				next = t->next;
+				if (t->GetOwner() == m)
+					delete t;
+			}
+		}
+}
+
+time_t TimerManager::NextTimer()
+{
+	for (int level = 0; level < Levels; ++level)
 	{
-		++it_next;
-		if (it->second->GetOwner() == m)
-			delete it->second;
+		if (!LevelCount[level])
+			continue;
+
+		int shift = LevelBits * level;
+		time_t rotation = (WheelTime >> shift) & ~static_cast<time_t>(Slots - 1);
+		for (int slot = (WheelTime >> shift) & (Slots - 1); slot < Slots; ++slot)
+			if (Wheel[level][slot].head)
+				return std::max((rotation + slot) << shift, WheelTime);
 	}
+
+	time_t next = -1;
+	for (Timer *t = Overflow.head; t; t = t->next)
+		if (next == -1 || t->GetTimer() < next)
+			next = t->GetTimer();
+	return next;
+}
+
+long TimerManager::GetTimeout(long max)
+{
+	time_t next = NextTimer();
+	if (next == -1)
+		return max;
+
+	timeval now;
+	gettimeofday(&now, NULL);
+
+	if (next <= now.tv_sec)
+		return 0;
+
+	time_t ms = (next - now.tv_sec) * 1000 - now.tv_usec / 1000;
+	return ms < max ? static_cast<long>(ms) : max;
+}
+
+ElapsedTimer::ElapsedTimer()
+{
+	this->Reset();
+}
+
+void ElapsedTimer::Reset()
+{
+	timeval now;
+	gettimeofday(&now, NULL);
+	this->start_sec = now.tv_sec;
+	this->start_usec = now.tv_usec;
+}
+
+long ElapsedTimer::Elapsed() const
+{
+	timeval now;
+	gettimeofday(&now, NULL);
+	return (now.tv_sec - this->start_sec) * 1000 + (now.tv_usec - this->start_usec) / 1000;
 }
@@ -131,12 +131,25 @@ UplinkSocket::~UplinkSocket()
 bool UplinkSocket::ProcessRead()
 {
 	bool b = BufferedSocket::ProcessRead();
-	for (Anope::string buf; (buf = this->GetLine()).empty() == false;)
+	const char *line;
+	size_t len;
+	/* Everything sent in reply to this batch of lines goes out together afterwards */
+	this->Cork();
+	try
 	{
-		Anope::Process(buf);
-		User::QuitUsers();
-		Channel::DeleteChannels();
+		while (this->GetLine(line, len))
+		{
+			Anope::Process(Anope::string(line, len));
+			User::QuitUsers();
+			Channel::DeleteChannels();
+		}
+	}
+	catch (...)
+	{
+		this->Uncork();
+		throw;
 	}
+	this->Uncork();
 	return b;
 }
 
@@ -17,6 +17,12 @@
 
 #define O_NONBLOCK 1
 
+struct iovec
+{
+	void *iov_base;
+	size_t iov_len;
+};
+
 extern CoreExport int read(int fd, char *buf, size_t count);
 extern CoreExport int write(int fd, const char *buf, size_t count);
 extern CoreExport int windows_close(int fd);
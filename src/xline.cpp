@@ -25,6 +25,11 @@ Serialize::Checker<std::multimap<Anope::string, XLine *, ci::less> > XLineManage
 
 void XLine::Init()
 {
+	this->nick.clear();
+	this->user.clear();
+	this->host.clear();
+	this->real.clear();
+
 	if (this->mask.length() >= 2 && this->mask[0] == '/' && this->mask[this->mask.length() - 1] == '/' && !Config->GetBlock("options")->Get<const Anope::string>("regexengine").empty())
 	{
 		Anope::string stripped_mask = this->mask.substr(1, this->mask.length() - 2);
@@ -151,23 +156,26 @@ bool XLine::IsRegex() const
 	return !this->mask.empty() && this->mask[0] == '/' && this->mask[this->mask.length() - 1] == '/';
 }
 
+static const Serialize::Key mask_key("mask"), by_key("by"), created_key("created"), expires_key("expires"), reason_key("reason"),
+	uid_key("uid"), manager_key("manager");
+
 void XLine::Serialize(Serialize::Data &data) const
 {
-	data["mask"] << this->mask;
-	data["by"] << this->by;
-	data["created"] << this->created;
-	data["expires"] << this->expires;
-	data["reason"] << this->reason;
-	data["uid"] << this->id;
+	data.Set(mask_key, this->mask);
+	data.Set(by_key, this->by);
+	data.Set(created_key, this->created);
+	data.Set(expires_key, this->expires);
+	data.Set(reason_key, this->reason);
+	data.Set(uid_key, this->id);
 	if (this->manager)
-		data["manager"] << this->manager->name;
+		data.Set(manager_key, this->manager->name);
 }
 
 Serializable* XLine::Unserialize(Serializable *obj, Serialize::Data &data)
 {
 	Anope::string smanager;
 
-	data["manager"] >> smanager;
+	data.Get(manager_key, smanager);
 
 	ServiceReference<XLineManager> xlm("XLineManager", smanager);
 	if (!xlm)
@@ -177,33 +185,46 @@ Serializable* XLine::Unserialize(Serializable *obj, Serialize::Data &data)
 	if (obj)
 	{
 		xl = anope_dynamic_static_cast<XLine *>(obj);
-		data["mask"] >> xl->mask;
-		data["by"] >> xl->by;
-		data["reason"] >> xl->reason;
-		data["uid"] >> xl->id;
+		Anope::string old_mask = xl->mask;
+		data.Get(mask_key, xl->mask);
+		data.Get(by_key, xl->by);
+		data.Get(reason_key, xl->reason);
+		data.Get(uid_key, xl->id);
+
+		if (xl->mask != old_mask)
+		{
+			/* The parts of the mask, and where the manager has indexed it, are for the old mask */
+			delete xl->regex;
+			xl->regex = NULL;
+			delete xl->c;
+			xl->c = NULL;
+			xl->Init();
+		}
 
 		if (xlm != xl->manager)
 		{
 			xl->manager->DelXLine(xl);
 			xlm->AddXLine(xl);
 		}
+		else if (xl->mask != old_mask)
+			xlm->ReindexXLine(xl);
 	}
 	else
 	{
 		Anope::string smask, sby, sreason, suid;
 		time_t expires;
 
-		data["mask"] >> smask;
-		data["by"] >> sby;
-		data["reason"] >> sreason;
-		data["uid"] >> suid;
-		data["expires"] >> expires;
+		data.Get(mask_key, smask);
+		data.Get(by_key, sby);
+		data.Get(reason_key, sreason);
+		data.Get(uid_key, suid);
+		data.Get(expires_key, expires);
 
 		xl = new XLine(smask, sby, expires, sreason, suid);
 		xlm->AddXLine(xl);
 	}
 
-	data["created"] >> xl->created;
+	data.Get(created_key, xl->created);
 	xl->manager = xlm;
 
 	return xl;
@@ -261,13 +282,228 @@ Anope::string XLineManager::GenerateUID()
 	return id;
 }
 
-XLineManager::XLineManager(Module *creator, const Anope::string &xname, char t) : Service(creator, "XLineManager", xname), type(t), xlines("XLine")
+struct XLineManager::Index
+{
+	/* A node of the tree of masks like *.example.com, which is keyed on the labels of the
+	 * mask from the right, so the masks ending in .com are all under one node.
+	 */
+	struct SuffixNode
+	{
+		Anope::hash_map<SuffixNode *> children;
+		std::vector<XLine *> xlines;
+
+		~SuffixNode()
+		{
+			for (Anope::hash_map<SuffixNode *>::iterator it = children.begin(), it_end = children.end(); it != it_end; ++it)
+				delete it->second;
+		}
+	};
+
+	enum EntryType
+	{
+		ENTRY_EXACT,
+		ENTRY_SUFFIX,
+		ENTRY_OTHER
+	};
+
+	struct Entry
+	{
+		/* When the xline was added, newer xlines are checked first */
+		unsigned long order;
+		EntryType type;
+		Anope::string mask;
+		bool range;
+	};
+
+	unsigned long next_order;
+	TR1NS::unordered_map<XLine *, Entry> entries;
+	TR1NS::unordered_multimap<Anope::string, XLine *, Anope::hash_ci, Anope::compare> exact;
+	SuffixNode suffixes;
+	CIDRTree<XLine *> ranges;
+	/* Masks which can not be indexed, by order */
+	std::map<unsigned long, XLine *> others;
+
+	Index() : next_order(0) { }
+
+	static bool IsWild(const Anope::string &mask, size_t start)
+	{
+		return mask.find_first_of("*?", start) != Anope::string::npos;
+	}
+
+	void Add(XLine *x, const Anope::string &mask)
+	{
+		/* An xline which is indexed again keeps its place in the order */
+		TR1NS::unordered_map<XLine *, Entry>::const_iterator it = this->entries.find(x);
+		unsigned long order = it != this->entries.end() ? it->second.order : this->next_order++;
+		this->Remove(x);
+
+		Entry &e = this->entries[x];
+		e.order = order;
+		e.mask = mask;
+		e.range = false;
+
+		if (!mask.empty() && !IsWild(mask, 0))
+		{
+			e.type = ENTRY_EXACT;
+			this->exact.insert(std::make_pair(mask, x));
+
+			if (mask.find('/') != Anope::string::npos && cidr(mask).valid())
+			{
+				e.range = true;
+				this->ranges.insert(cidr(mask), x);
+			}
+		}
+		else if (mask.length() >= 2 && mask[0] == '*' && mask[1] == '.' && !IsWild(mask, 1))
+		{
+			e.type = ENTRY_SUFFIX;
+
+			SuffixNode *node = &this->suffixes;
+			for (size_t end = mask.length(), dot; end > 1; end = dot)
+			{
+				dot = mask.rfind('.', end - 1);
+				SuffixNode *&child = node->children[mask.substr(dot + 1, end - dot - 1)];
+				if (!child)
+					child = new SuffixNode();
+				node = child;
+			}
+			node->xlines.push_back(x);
+		}
+		else
+		{
+			e.type = ENTRY_OTHER;
+			this->others[e.order] = x;
+		}
+	}
+
+	/* Removes x from the suffix node for mask[1, end), and returns whether node is now empty */
+	static bool RemoveSuffix(SuffixNode *node, const Anope::string &mask, size_t end, XLine *x)
+	{
+		if (end <= 1)
+		{
+			std::vector<XLine *>::iterator it = std::find(node->xlines.begin(), node->xlines.end(), x);
+			if (it != node->xlines.end())
+				node->xlines.erase(it);
+		}
+		else
+		{
+			size_t dot = mask.rfind('.', end - 1);
+			Anope::hash_map<SuffixNode *>::iterator it = node->children.find(mask.substr(dot + 1, end - dot - 1));
+			if (it != node->children.end() && RemoveSuffix(it->second, mask, dot, x))
+			{
+				delete it->second;
+				node->children.erase(it);
+			}
+		}
+
+		return node->xlines.empty() && node->children.empty();
+	}
+
+	void Remove(XLine *x)
+	{
+		TR1NS::unordered_map<XLine *, Entry>::iterator it = this->entries.find(x);
+		if (it == this->entries.end())
+			return;
+		const Entry &e = it->second;
+
+		switch (e.type)
+		{
+			case ENTRY_EXACT:
+			{
+				typedef TR1NS::unordered_multimap<Anope::string, XLine *, Anope::hash_ci, Anope::compare>::iterator exact_iterator;
+				std::pair<exact_iterator, exact_iterator> range = this->exact.equal_range(e.mask);
+				for (exact_iterator it2 = range.first; it2 != range.second; ++it2)
+					if (it2->second == x)
+					{
+						this->exact.erase(it2);
+						break;
+					}
+				if (e.range)
+					this->ranges.erase(cidr(e.mask), x);
+				break;
+			}
+			case ENTRY_SUFFIX:
+				RemoveSuffix(&this->suffixes, e.mask, e.mask.length(), x);
+				break;
+			case ENTRY_OTHER:
+				this->others.erase(e.order);
+		}
+
+		this->entries.erase(it);
+	}
+
+	void Clear()
+	{
+		this->entries.clear();
+		this->exact.clear();
+		for (Anope::hash_map<SuffixNode *>::iterator it = this->suffixes.children.begin(), it_end = this->suffixes.children.end(); it != it_end; ++it)
+			delete it->second;
+		this->suffixes.children.clear();
+		this->suffixes.xlines.clear();
+		this->ranges.clear();
+		this->others.clear();
+	}
+
+	/* Finds the xlines a user could match, newest first */
+	void Find(User *u, const std::vector<Anope::string> &keys, std::vector<XLine *> &xlines)
+	{
+		std::vector<XLine *> found;
+
+		for (unsigned i = 0; i < keys.size(); ++i)
+		{
+			const Anope::string &key = keys[i];
+
+			typedef TR1NS::unordered_multimap<Anope::string, XLine *, Anope::hash_ci, Anope::compare>::const_iterator exact_iterator;
+			std::pair<exact_iterator, exact_iterator> range = this->exact.equal_range(key);
+			for (exact_iterator it = range.first; it != range.second; ++it)
+				found.push_back(it->second);
+
+			/* Walk the labels of the key from the right, each node reached with a . before
+			 * the label holds the masks which end at that label.
+			 */
+			const SuffixNode *node = &this->suffixes;
+			for (size_t end = key.length(), dot; end > 0 && (dot = key.rfind('.', end - 1)) != Anope::string::npos; end = dot)
+			{
+				Anope::hash_map<SuffixNode *>::const_iterator it = node->children.find(key.substr(dot + 1, end - dot - 1));
+				if (it == node->children.end())
+					break;
+				node = it->second;
+				found.insert(found.end(), node->xlines.begin(), node->xlines.end());
+			}
+		}
+
+		this->ranges.find(u->ip, found);
+
+		std::vector<std::pair<unsigned long, XLine *> > ordered;
+		ordered.reserve(found.size());
+		for (unsigned i = 0; i < found.size(); ++i)
+			ordered.push_back(std::make_pair(this->entries[found[i]].order, found[i]));
+		std::sort(ordered.begin(), ordered.end());
+
+		/* Merge the indexed matches with the unindexed masks, which are already in order */
+		xlines.reserve(xlines.size() + ordered.size() + this->others.size());
+		std::map<unsigned long, XLine *>::const_reverse_iterator oit = this->others.rbegin(), oit_end = this->others.rend();
+		for (unsigned i = ordered.size(); i > 0; --i)
+		{
+			if (i < ordered.size() && ordered[i - 1].second == ordered[i].second)
+				continue;
+
+			for (; oit != oit_end && oit->first > ordered[i - 1].first; ++oit)
+				xlines.push_back(oit->second);
+			xlines.push_back(ordered[i - 1].second);
+		}
+		for (; oit != oit_end; ++oit)
+			xlines.push_back(oit->second);
+	}
+};
+
+XLineManager::XLineManager(Module *creator, const Anope::string &xname, char t) : Service(creator, "XLineManager", xname), type(t), xlines("XLine"), xline_index(new Index()), next_expiry_check(0)
 {
 }
 
 XLineManager::~XLineManager()
 {
 	this->Clear();
+	delete this->xline_index;
 }
 
 const char &XLineManager::Type()
@@ -291,12 +527,18 @@ void XLineManager::AddXLine(XLine *x)
 		XLinesByUID->insert(std::make_pair(x->id, x));
 	this->xlines->push_back(x);
 	x->manager = this;
+
+	this->xline_index->Add(x, this->GetIndexMask(x));
+	if (x->expires && (!this->next_expiry_check || x->expires < this->next_expiry_check))
+		this->next_expiry_check = x->expires;
 }
 
 void XLineManager::RemoveXLine(XLine *x)
 {
 	/* called from the destructor */
 
+	this->xline_index->Remove(x);
+
 	std::vector<XLine *>::iterator it = std::find(this->xlines->begin(), this->xlines->end(), x);
 
 	if (!x->id.empty())
@@ -317,8 +559,15 @@ void XLineManager::RemoveXLine(XLine *x)
 	}
 }
 
+void XLineManager::ReindexXLine(XLine *x)
+{
+	this->xline_index->Add(x, this->GetIndexMask(x));
+}
+
 bool XLineManager::DelXLine(XLine *x)
 {
+	this->xline_index->Remove(x);
+
 	std::vector<XLine *>::iterator it = std::find(this->xlines->begin(), this->xlines->end(), x);
 
 	if (!x->id.empty())
@@ -360,6 +609,7 @@ void XLineManager::Clear()
 {
 	std::vector<XLine *> xl;
 	this->xlines->swap(xl);
+	this->xline_index->Clear();
 
 	for (unsigned i = 0; i < xl.size(); ++i)
 	{
@@ -441,12 +691,45 @@ XLine* XLineManager::HasEntry(const Anope::string &mask)
 	return NULL;
 }
 
-XLine *XLineManager::CheckAllXLines(User *u)
+void XLineManager::Expire()
 {
+	/* Look again in a minute at the latest, in case an expiry time was changed */
+	this->next_expiry_check = Anope::CurTime + 60;
+
 	for (unsigned i = this->xlines->size(); i > 0; --i)
 	{
 		XLine *x = this->xlines->at(i - 1);
 
+		if (!x->expires)
+			continue;
+		else if (x->expires < Anope::CurTime)
+		{
+			this->OnExpire(x);
+			this->DelXLine(x);
+		}
+		else if (x->expires < this->next_expiry_check)
+			this->next_expiry_check = x->expires;
+	}
+}
+
+XLine *XLineManager::CheckAllXLines(User *u)
+{
+	if (this->xlines->empty())
+		return NULL;
+
+	if (this->next_expiry_check && this->next_expiry_check < Anope::CurTime)
+		this->Expire();
+
+	std::vector<Anope::string> keys;
+	this->GetIndexKeys(u, keys);
+
+	std::vector<XLine *> candidates;
+	this->xline_index->Find(u, keys, candidates);
+
+	for (unsigned i = 0; i < candidates.size(); ++i)
+	{
+		XLine *x = candidates[i];
+
 		if (x->expires && x->expires < Anope::CurTime)
 		{
 			this->OnExpire(x);
@@ -464,6 +747,15 @@ XLine *XLineManager::CheckAllXLines(User *u)
 	return NULL;
 }
 
+Anope::string XLineManager::GetIndexMask(const XLine *x)
+{
+	return "";
+}
+
+void XLineManager::GetIndexKeys(User *u, std::vector<Anope::string> &keys)
+{
+}
+
 void XLineManager::OnExpire(const XLine *x)
 {
 }